@@ -0,0 +1,242 @@
+//times the original A* against the current one on the same queries. the
+//original is kept below as it was before the heap and the node arena, with
+//shared_ptr nodes, a sorted vector for the open list and linear scans of the
+//open and closed lists. only its reads of the grid changed, to go through
+//tile_blocked and stay on the map, and its sort compares with > where it had
+//>=, which std::sort is free to run off the end of the vector with. its cap
+//of 650 tries was never counted, so it has none here either. load_random_map
+//is gone, so the maps come from generate_dungeon at the size it used, 100x90.
+//
+//the second half times searches that can't succeed on a big map, a dest
+//walled in on every side and a sealed room, with and without the node budget.
+//
+//  astar_bench [--width 100] [--height 90] [--seed 1] [--queries 200]
+//              [--big 2048]
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include "core.h"
+#include "map.h"
+#include "mapgen.h"
+
+//
+//   ORIGINAL A*
+//
+
+struct OldNode;
+typedef std::shared_ptr<OldNode> OldNodePtr;
+struct OldNode {
+    OldNode(i32 x, i32 y, OldNodePtr parent, i32 fcost) {
+        this->x = x;
+        this->y = y;
+        this->parent = parent;
+        this->fcost = fcost;
+    }
+    i32 x;
+    i32 y;
+    OldNodePtr parent;
+    i32 fcost;
+};
+
+static inline
+bool old_compare_ptr_to_node(OldNodePtr a, OldNodePtr b) {
+    return (a->fcost > b->fcost);
+}
+
+static inline
+void old_process_successor(i32 x, i32 y, i32 fcost, OldNodePtr parent, std::vector<OldNodePtr>& open, std::vector<OldNodePtr>& closed) {
+    for(u32 i = 0; i < open.size(); ++i) {
+        if(open[i]->x == x && open[i]->y == y) {
+            if(open[i]->fcost <= fcost)
+                return;
+            break;
+        }
+    }
+    for(u32 i = 0; i < closed.size(); ++i) {
+        if(closed[i]->x == x && closed[i]->y == y) {
+            if(closed[i]->fcost <= fcost)
+                return;
+            break;
+        }
+    }
+    open.push_back(OldNodePtr(new OldNode(x, y, parent, fcost)));
+}
+
+static inline
+std::vector<vec2> old_reconstruct_path(OldNodePtr current) {
+    std::vector<vec2> path;
+    while(current->parent != NULL) {
+        path.push_back({(f32)current->x, (f32)current->y});
+        current = current->parent;
+    }
+    path.push_back({(f32)current->x, (f32)current->y});
+    return path;
+}
+
+static inline
+std::vector<vec2> old_pathfind_astar(Map* map, vec2 start, vec2 dest) {
+    std::vector<OldNodePtr> open;
+    std::vector<OldNodePtr> closed;
+    OldNodePtr current;
+    open.push_back(OldNodePtr(new OldNode(start.x, start.y, NULL, 0)));
+
+    const i32 dx[8] = {-1, 1, 0, 0, 1, -1, -1, 1};
+    const i32 dy[8] = {0, 0, -1, 1, 1, -1, 1, -1};
+#ifdef DIAGONAL_ASTAR
+    const i32 directions = 8;
+#else
+    const i32 directions = 4;
+#endif
+
+    while(!open.empty()) {
+        std::sort(open.begin(), open.end(), old_compare_ptr_to_node);
+        current = open.back();
+        open.pop_back();
+        closed.push_back(current);
+
+        if(current->x == dest.x && current->y == dest.y)
+            return old_reconstruct_path(current);
+
+        for(i32 i = 0; i < directions; ++i) {
+            i32 x = current->x + dx[i];
+            i32 y = current->y + dy[i];
+            if(x < 0 || y < 0 || x >= map->width || y >= map->height)
+                continue;
+            if(!tile_blocked(map, x, y))
+                old_process_successor(x, y, current->fcost + getDistanceE(x, y, dest.x, dest.y), current, open, closed);
+            else if(dest.x == x && dest.y == y)
+                return old_reconstruct_path(current);
+        }
+    }
+
+    std::vector<vec2> blank;
+    blank.push_back(start);
+    return blank;
+}
+
+//
+//   BENCH
+//
+
+static inline
+vec2 random_open_tile(Map* map, Rng* rng) {
+    for(;;) {
+        i32 x = random_int(rng, 1, map->width - 2);
+        i32 y = random_int(rng, 1, map->height - 2);
+        if(!tile_blocked(map, x, y))
+            return V2(x, y);
+    }
+}
+
+//walls in the w x h rectangle at (x, y) and digs out its inside
+static inline
+void seal_room(Map* map, i32 x, i32 y, i32 w, i32 h) {
+    for(i32 j = y; j < y + h; ++j)
+        for(i32 i = x; i < x + w; ++i)
+            set_tile(map, i, j, i == x || j == y || i == x + w - 1 || j == y + h - 1 ? GEN_WALL : GEN_FLOOR);
+}
+
+static inline
+f64 time_search(Map* map, vec2 start, vec2 dest, u32 budget, std::vector<vec2>* path) {
+    PathGrid* grid = get_path_grid(map);
+    grid->budget = budget;
+    u64 begin = get_nanoseconds();
+    pathfind_astar(map, grid, start, dest, path);
+    f64 ms = (get_nanoseconds() - begin) / 1e6;
+    grid->budget = PATH_NODE_BUDGET;
+    return ms;
+}
+
+int main(int argc, char** argv) {
+    i32 width = 100;
+    i32 height = 90;
+    u32 seed = 1;
+    u32 queries = 200;
+    i32 big = 2048;
+    for(i32 i = 1; i + 1 < argc; i += 2) {
+        const char* arg = argv[i];
+        const char* value = argv[i + 1];
+        if(strcmp(arg, "--width") == 0) width = atoi(value);
+        else if(strcmp(arg, "--height") == 0) height = atoi(value);
+        else if(strcmp(arg, "--seed") == 0) seed = strtoul(value, NULL, 10);
+        else if(strcmp(arg, "--queries") == 0) queries = atoi(value);
+        else if(strcmp(arg, "--big") == 0) big = atoi(value);
+        else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return 1;
+        }
+    }
+    if(width < 24 || height < 24 || big < 24) {
+        fprintf(stderr, "maps need to be at least 24x24\n");
+        return 1;
+    }
+
+    Rng rng;
+    seed_rng(&rng, seed);
+    DungeonGenStats gen;
+    Map map = generate_dungeon(width, height, 1, &rng, &gen);
+
+    std::vector<vec2> starts;
+    std::vector<vec2> dests;
+    for(u32 i = 0; i < queries; ++i) {
+        starts.push_back(random_open_tile(&map, &rng));
+        dests.push_back(random_open_tile(&map, &rng));
+    }
+
+    //both find a path or neither does, the old one's paths are not always
+    //the shortest so only the lengths are summed
+    u32 oldfound = 0;
+    u32 oldlength = 0;
+    u64 begin = get_nanoseconds();
+    for(u32 i = 0; i < queries; ++i) {
+        std::vector<vec2> path = old_pathfind_astar(&map, starts[i], dests[i]);
+        oldfound += path.size() > 1;
+        oldlength += path.size();
+    }
+    f64 oldms = (get_nanoseconds() - begin) / 1e6;
+
+    //the first search allocates the grid, the second pass is warm
+    std::vector<vec2> path;
+    u32 newfound = 0;
+    u32 newlength = 0;
+    begin = get_nanoseconds();
+    for(u32 i = 0; i < queries; ++i) {
+        pathfind_astar(&map, starts[i], dests[i], &path);
+        newfound += path.size() > 1;
+        newlength += path.size();
+    }
+    f64 coldms = (get_nanoseconds() - begin) / 1e6;
+    begin = get_nanoseconds();
+    for(u32 i = 0; i < queries; ++i)
+        pathfind_astar(&map, starts[i], dests[i], &path);
+    f64 warmms = (get_nanoseconds() - begin) / 1e6;
+    dispose_map(&map);
+
+    //a dest sealed in on all sides is turned away before searching. a sealed
+    //room is not, the budget is what stops that search.
+    Map bigmap = generate_dungeon(big, big, 0, &rng, &gen);
+    vec2 bigstart = gen.start; //in the first room, far from the corner
+    seal_room(&bigmap, big - 12, big - 12, 3, 3);
+    seal_room(&bigmap, big - 8, big - 8, 5, 5);
+    vec2 sealed = V2(big - 11, big - 11);
+    vec2 room = V2(big - 6, big - 6);
+    f64 sealedms = time_search(&bigmap, bigstart, sealed, PATH_NODE_BUDGET, &path);
+    f64 budgetms = time_search(&bigmap, bigstart, room, PATH_NODE_BUDGET, &path);
+    f64 floodms = time_search(&bigmap, bigstart, room, 0, &path);
+    u32 flooded = get_path_grid(&bigmap)->nodecount;
+    dispose_map(&bigmap);
+
+    printf("{\n");
+    printf("  \"width\": %d, \"height\": %d, \"seed\": %u, \"queries\": %u,\n", width, height, seed, queries);
+    printf("  \"old_ms\": %.3f, \"old_us_per_search\": %.2f, \"old_found\": %u, \"old_path_tiles\": %u,\n",
+           oldms, oldms * 1000 / queries, oldfound, oldlength);
+    printf("  \"new_cold_ms\": %.3f, \"new_warm_ms\": %.3f, \"new_us_per_search\": %.2f, \"new_found\": %u, \"new_path_tiles\": %u,\n",
+           coldms, warmms, warmms * 1000 / queries, newfound, newlength);
+    printf("  \"speedup\": %.1f,\n", warmms > 0 ? oldms / warmms : 0);
+    printf("  \"big\": %d, \"node_budget\": %u,\n", big, PATH_NODE_BUDGET);
+    printf("  \"unreachable_sealed_ms\": %.3f, \"unreachable_budget_ms\": %.3f, \"unreachable_unbounded_ms\": %.3f, \"unbounded_nodes\": %u\n",
+           sealedms, budgetms, floodms, flooded);
+    printf("}\n");
+    return 0;
+}
@@ -0,0 +1,214 @@
+//checks the autotiler three ways on random maps put through random digs and
+//fills, exiting non-zero if any of them fails:
+//
+//  - redoing the 3x3 around each changed tile, the way orient_dirty_tiles
+//    does, leaves the same grid as a full orient_tiles pass
+//  - the full pass agrees tile for tile with the rules written out one tile
+//    at a time below, reading the map edge as blocked. a neighbor read past
+//    the last row or column shows up here.
+//  - no graphic disagrees with whether its tile is blocked. an isolated
+//    floor tile given a wall graphic (13 rather than 11) shows up here.
+//
+//  autotile_check [--seeds 200] [--ticks 100]
+
+#include <vector>
+#include "core.h"
+#include "map.h"
+#include "mapgen.h"
+
+//off the map counts as blocked
+static inline
+bool blocked_at(Map* map, i32 x, i32 y) {
+    if(x < 0 || y < 0 || x >= map->width || y >= map->height)
+        return true;
+    return tile_blocked(map, x, y);
+}
+
+//the autotile rules as they read before they became a table, one tile at a
+//time. -1 when no rule matches and the tile keeps its graphic.
+static inline
+i32 reference_tile(Map* map, i32 x, i32 y) {
+    bool upblocked = blocked_at(map, x, y - 1);
+    bool downblocked = blocked_at(map, x, y + 1);
+    bool leftblocked = blocked_at(map, x - 1, y);
+    bool rightblocked = blocked_at(map, x + 1, y);
+
+    i32 id = -1;
+    if(tile_blocked(map, x, y)) {
+        if(downblocked && rightblocked)
+            id = 0;
+        if(downblocked && leftblocked)
+            id = 2;
+        if(upblocked && rightblocked)
+            id = 0 + 2 * TILESET_WIDTH;
+        if(upblocked && leftblocked)
+            id = 2 + 2 * TILESET_WIDTH;
+        if((!leftblocked || !rightblocked) && upblocked && downblocked)
+            id = 0 + 1 * TILESET_WIDTH;
+        if((!downblocked || !upblocked) && leftblocked && rightblocked)
+            id = 1 + 0 * TILESET_WIDTH;
+        if(!upblocked && !downblocked && !rightblocked && !leftblocked)
+            id = 1 + 1 * TILESET_WIDTH;
+        if(upblocked && downblocked && rightblocked && leftblocked) {
+            id = 1 + 2 * TILESET_WIDTH;
+            if(!blocked_at(map, x - 1, y - 1))
+                id = 2 + 2 * TILESET_WIDTH;
+            if(!blocked_at(map, x + 1, y - 1))
+                id = 0 + 2 * TILESET_WIDTH;
+            if(!blocked_at(map, x - 1, y + 1))
+                id = 2 + 0 * TILESET_WIDTH;
+            if(!blocked_at(map, x + 1, y + 1))
+                id = 0;
+        }
+        return id;
+    }
+
+    if(leftblocked)
+        id = 6 + 1 * TILESET_WIDTH;
+    if(upblocked)
+        id = 7 + 0 * TILESET_WIDTH;
+    if(rightblocked)
+        id = 8 + 1 * TILESET_WIDTH;
+    if(downblocked)
+        id = 7 + 2 * TILESET_WIDTH;
+    if(upblocked && leftblocked)
+        id = 6 + 0 * TILESET_WIDTH;
+    if(upblocked && rightblocked)
+        id = 8 + 0 * TILESET_WIDTH;
+    if(downblocked && leftblocked)
+        id = 6 + 2 * TILESET_WIDTH;
+    if(downblocked && rightblocked)
+        id = 8 + 2 * TILESET_WIDTH;
+    if(upblocked && leftblocked && rightblocked)
+        id = 9 + 0 * TILESET_WIDTH;
+    if(leftblocked && rightblocked)
+        id = 9 + 1 * TILESET_WIDTH;
+    if(downblocked && leftblocked && rightblocked)
+        id = 9 + 2 * TILESET_WIDTH;
+    if(upblocked && leftblocked && downblocked)
+        id = 10 + 1 * TILESET_WIDTH;
+    if(upblocked && downblocked)
+        id = 11 + 1 * TILESET_WIDTH;
+    if(upblocked && rightblocked && downblocked)
+        id = 12 + 1 * TILESET_WIDTH;
+    if(upblocked && downblocked && rightblocked && leftblocked)
+        id = 11 + 0 * TILESET_WIDTH;
+    if(!upblocked && !downblocked && !rightblocked && !leftblocked)
+        id = 7 + 1 * TILESET_WIDTH;
+    return id;
+}
+
+static inline
+Map copy_map(Map* map) {
+    Map copy = create_map(map->width, map->height, GEN_WALL);
+    for(i32 y = 0; y < map->height; ++y)
+        for(i32 x = 0; x < map->width; ++x)
+            set_tile(&copy, x, y, get_tile(map, x, y));
+    return copy;
+}
+
+//the first tile where a and b differ, false if there is none
+static inline
+bool first_difference(Map* a, Map* b, i32* x, i32* y) {
+    for(*y = 0; *y < a->height; ++*y)
+        for(*x = 0; *x < a->width; ++*x)
+            if(get_tile(a, *x, *y) != get_tile(b, *x, *y))
+                return true;
+    return false;
+}
+
+//checks every tile of a freshly oriented map against the rules and its own
+//passability. before is the grid as it was before the pass.
+static inline
+const char* check_full_pass(Map* map, Map* before, i32* x, i32* y) {
+    for(*y = 0; *y < map->height; ++*y) {
+        for(*x = 0; *x < map->width; ++*x) {
+            i32 id = reference_tile(map, *x, *y);
+            if(id == -1)
+                id = get_tile(before, *x, *y);
+            if(get_tile(map, *x, *y) != id)
+                return "full pass disagrees with the reference rules";
+            if(blocked_tile(id) != tile_blocked(map, *x, *y))
+                return "graphic disagrees with passability";
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    u32 seeds = 200;
+    u32 ticks = 100;
+    for(i32 i = 1; i + 1 < argc; i += 2) {
+        if(strcmp(argv[i], "--seeds") == 0) seeds = atoi(argv[i + 1]);
+        else if(strcmp(argv[i], "--ticks") == 0) ticks = atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    std::vector<vec2> dirty;
+    u32 checked = 0;
+    u32 failures = 0;
+    for(u32 seed = 1; seed <= seeds && failures == 0; ++seed) {
+        Rng rng;
+        seed_rng(&rng, seed);
+
+        //small odd sizes so the last row and column land mid chunk as often
+        //as not, every fourth seed a generated dungeon
+        Map incremental;
+        if(seed % 4 == 0) {
+            DungeonGenStats stats;
+            incremental = generate_dungeon(random_int(&rng, 24, 80), random_int(&rng, 24, 80), 1, &rng, &stats);
+        } else {
+            i32 width = random_int(&rng, 1, 40);
+            i32 height = random_int(&rng, 1, 40);
+            incremental = create_map(width, height, GEN_WALL);
+            for(i32 y = 0; y < height; ++y)
+                for(i32 x = 0; x < width; ++x)
+                    if(random_int(&rng, 0, 1))
+                        set_tile(&incremental, x, y, GEN_FLOOR);
+            orient_tiles(&incremental);
+        }
+        Map full = copy_map(&incremental);
+
+        for(u32 tick = 0; tick < ticks && failures == 0; ++tick) {
+            //mostly digs, with the odd fill so walls get rebuilt too
+            dirty.clear();
+            u32 changes = random_int(&rng, 1, 6);
+            for(u32 i = 0; i < changes; ++i) {
+                i32 x = random_int(&rng, 0, incremental.width - 1);
+                i32 y = random_int(&rng, 0, incremental.height - 1);
+                i32 id = random_int(&rng, 0, 3) == 0 ? GEN_WALL : GEN_FLOOR;
+                set_tile(&incremental, x, y, id);
+                set_tile(&full, x, y, id);
+                dirty.push_back(V2(x, y));
+            }
+
+            for(u32 i = 0; i < dirty.size(); ++i) {
+                i32 x = dirty[i].x;
+                i32 y = dirty[i].y;
+                orient_tiles_region(&incremental, x - 1, y - 1, x + 1, y + 1);
+            }
+            Map before = copy_map(&full);
+            orient_tiles(&full);
+            checked++;
+
+            i32 x, y;
+            const char* problem = check_full_pass(&full, &before, &x, &y);
+            if(problem == NULL && first_difference(&incremental, &full, &x, &y))
+                problem = "incremental update disagrees with the full pass";
+            if(problem != NULL) {
+                fprintf(stderr, "seed %u tick %u, %dx%d map, tile (%d, %d): %s\n",
+                        seed, tick, full.width, full.height, x, y, problem);
+                failures++;
+            }
+            dispose_map(&before);
+        }
+        dispose_map(&incremental);
+        dispose_map(&full);
+    }
+
+    printf("autotile: %u seeds, %u ticks checked, %u failures\n", seeds, checked, failures);
+    return failures == 0 ? 0 : 1;
+}
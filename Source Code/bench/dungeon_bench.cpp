@@ -0,0 +1,328 @@
+//runs scripted dungeons with no window and prints one json object per run, so
+//numbers can be diffed from commit to commit. it only includes the simulation
+//headers, built with BMT_HEADLESS so nothing links against gl, glfw, openal,
+//soil or freetype, see the Makefile. runs are seeded and the path service
+//runs in lockstep, so trace_hash only changes when the simulation does.
+//
+//  dungeon_bench [--width 100] [--height 90] [--size n] [--seed 1] [--imps 16]
+//                [--wanderers 0] [--mines 64] [--ticks 3000]
+//                [--pathfinder astar|jps|hpa] [--gen-threads 0]
+//                [--steer-kernel scalar|sse|avx2]
+//
+//--size sets width and height together. searches run on the path service's
+//workers whichever pathfinder is picked. with hpa each worker keeps its own
+//cluster graph, built on its first search and repaired after digs, so that
+//build lands in the first searches' times.
+//
+//the steer kernel defaults to the best the cpu has. all three move units the
+//same, so trace_hash should not change with it, only steer_units_per_ms.
+//after the run the map's 3x3 neighborhoods are read row by row and column by
+//column, through the chunked accessors and from a row-major copy, which is
+//where chunking should pay off on big maps, try --size 2048 --ticks 0.
+
+#include <vector>
+#include <algorithm>
+#include "core.h"
+#include "map.h"
+#include "mapgen.h"
+#include "dungeonsim.h"
+
+struct BenchConfig {
+    i32 width;
+    i32 height;
+    u32 seed;
+    u32 imps;
+    u32 wanderers; //non imps, the only units that ask the path service for searches
+    u32 mines;
+    u32 ticks;
+    u32 genthreads; //0 for one per core
+    Pathfinder pathfinder;
+    SteerKernel steerkernel;
+};
+
+static inline
+vec2 random_open_tile(Map* map, Rng* rng) {
+    for(;;) {
+        i32 x = random_int(rng, 1, map->width - 2);
+        i32 y = random_int(rng, 1, map->height - 2);
+        if(!tile_blocked(map, x, y))
+            return V2(x, y);
+    }
+}
+
+//queues walls that border open floor, so every one of them can be reached
+static inline
+void queue_random_mines(DungeonMap* map, u32 count) {
+    std::vector<vec2> walls;
+    for(i32 y = 1; y < map->map.height - 1; ++y) {
+        for(i32 x = 1; x < map->map.width - 1; ++x) {
+            if(!tile_blocked(&map->map, x, y))
+                continue;
+            if(!tile_blocked(&map->map, x - 1, y) || !tile_blocked(&map->map, x + 1, y) ||
+               !tile_blocked(&map->map, x, y - 1) || !tile_blocked(&map->map, x, y + 1))
+                walls.push_back(V2(x, y));
+        }
+    }
+    for(u32 i = 0; i < count && walls.size() > 0; ++i) {
+        u32 pick = random_int(&map->rng, 0, walls.size() - 1);
+        map->minequeue.push_back(walls[pick]);
+        walls[pick] = walls.back();
+        walls.pop_back();
+    }
+    map->mineflow.dirty = true;
+}
+
+static inline
+void setup_bench(DungeonMap* map, BenchConfig* config, DungeonGenStats* gen) {
+    seed_rng(&map->rng, config->seed);
+    map->map = generate_dungeon(config->width, config->height, config->genthreads, &map->rng, gen);
+    map->pathfinder = config->pathfinder;
+    start_path_service(&map->pathservice, 0, true);
+    map->steerkernel = config->steerkernel;
+
+    Unit unit = {0};
+    unit.hp = 10;
+    unit.mana = 10;
+    unit.type = UNIT_IMP;
+    for(u32 i = 0; i < config->imps; ++i)
+        spawn_unit(&map->units, random_open_tile(&map->map, &map->rng) * TILE_SIZE, &unit);
+    unit.type = UNIT_DEMON;
+    for(u32 i = 0; i < config->wanderers; ++i)
+        spawn_unit(&map->units, random_open_tile(&map->map, &map->rng) * TILE_SIZE, &unit);
+
+    queue_random_mines(map, config->mines);
+}
+
+//fnv-1a, folded over the unit positions every tick and the grid at the end
+static inline
+u64 hash_bytes(u64 hash, const void* data, u32 size) {
+    const u8* bytes = (const u8*)data;
+    for(u32 i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+//sorts samples in place
+static inline
+f64 percentile_ms(std::vector<u64>* samples, f64 percent) {
+    if(samples->size() == 0)
+        return 0;
+    std::sort(samples->begin(), samples->end());
+    u32 index = (u32)(percent / 100 * (samples->size() - 1) + 0.5);
+    return (*samples)[index] / 1e6;
+}
+
+static inline
+f64 total_ms(std::vector<u64>* samples) {
+    u64 total = 0;
+    for(u32 i = 0; i < samples->size(); ++i)
+        total += (*samples)[i];
+    return total / 1e6;
+}
+
+static inline
+void print_system(const char* name, std::vector<u64>* samples, bool last) {
+    f64 total = total_ms(samples);
+    printf("    \"%s\": {\"total_ms\": %.3f, \"p50_ms\": %.4f, \"p99_ms\": %.4f}%s\n",
+           name, total, percentile_ms(samples, 50), percentile_ms(samples, 99), last ? "" : ",");
+}
+
+//milliseconds for one pass over every interior tile's 3x3 neighborhood
+struct AccessTimes {
+    f64 chunkedrows;
+    f64 chunkedcolumns;
+    f64 flatrows;
+    f64 flatcolumns;
+    f64 orient; //a full orient_tiles pass
+    i64 checksum; //so the reads are not optimized out
+};
+
+static inline
+i64 sum_neighbors_chunked(Map* map, i32 x, i32 y) {
+    i64 sum = 0;
+    for(i32 j = y - 1; j <= y + 1; ++j)
+        for(i32 i = x - 1; i <= x + 1; ++i)
+            sum += get_tile(map, i, j);
+    return sum;
+}
+
+static inline
+i64 sum_neighbors_flat(i32* grid, i32 width, i32 x, i32 y) {
+    i64 sum = 0;
+    for(i32 j = y - 1; j <= y + 1; ++j)
+        for(i32 i = x - 1; i <= x + 1; ++i)
+            sum += grid[i + j * width];
+    return sum;
+}
+
+//columns first is the order the old orient_tiles walked the grid in, and how
+//the vertical jump scans read it
+static inline
+void time_map_access(Map* map, AccessTimes* out) {
+    i32 width = map->width;
+    i32 height = map->height;
+    std::vector<i32> flat(width * height);
+    for(i32 y = 0; y < height; ++y)
+        for(i32 x = 0; x < width; ++x)
+            flat[x + y * width] = get_tile(map, x, y);
+
+    out->checksum = 0;
+    u64 start = get_nanoseconds();
+    for(i32 y = 1; y < height - 1; ++y)
+        for(i32 x = 1; x < width - 1; ++x)
+            out->checksum += sum_neighbors_chunked(map, x, y);
+    u64 now = get_nanoseconds();
+    out->chunkedrows = (now - start) / 1e6;
+    start = now;
+    for(i32 x = 1; x < width - 1; ++x)
+        for(i32 y = 1; y < height - 1; ++y)
+            out->checksum += sum_neighbors_chunked(map, x, y);
+    now = get_nanoseconds();
+    out->chunkedcolumns = (now - start) / 1e6;
+    start = now;
+    for(i32 y = 1; y < height - 1; ++y)
+        for(i32 x = 1; x < width - 1; ++x)
+            out->checksum += sum_neighbors_flat(flat.data(), width, x, y);
+    now = get_nanoseconds();
+    out->flatrows = (now - start) / 1e6;
+    start = now;
+    for(i32 x = 1; x < width - 1; ++x)
+        for(i32 y = 1; y < height - 1; ++y)
+            out->checksum += sum_neighbors_flat(flat.data(), width, x, y);
+    now = get_nanoseconds();
+    out->flatcolumns = (now - start) / 1e6;
+
+    //the map is already oriented, so this changes nothing
+    start = get_nanoseconds();
+    orient_tiles(map);
+    out->orient = (get_nanoseconds() - start) / 1e6;
+}
+
+static inline
+const char* pathfinder_name(Pathfinder pathfinder) {
+    switch(pathfinder) {
+        case PATHFINDER_ASTAR: return "astar";
+        case PATHFINDER_JPS: return "jps";
+        case PATHFINDER_HPA: return "hpa";
+    }
+    return "unknown";
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config = {100, 90, 1, 16, 0, 64, 3000, 0, PATHFINDER_JPS, detect_steer_kernel()};
+    for(i32 i = 1; i + 1 < argc; i += 2) {
+        const char* arg = argv[i];
+        const char* value = argv[i + 1];
+        if(strcmp(arg, "--width") == 0) config.width = atoi(value);
+        else if(strcmp(arg, "--height") == 0) config.height = atoi(value);
+        else if(strcmp(arg, "--size") == 0) config.width = config.height = atoi(value);
+        else if(strcmp(arg, "--seed") == 0) config.seed = strtoul(value, NULL, 10);
+        else if(strcmp(arg, "--imps") == 0) config.imps = atoi(value);
+        else if(strcmp(arg, "--wanderers") == 0) config.wanderers = atoi(value);
+        else if(strcmp(arg, "--mines") == 0) config.mines = atoi(value);
+        else if(strcmp(arg, "--ticks") == 0) config.ticks = atoi(value);
+        else if(strcmp(arg, "--gen-threads") == 0) config.genthreads = atoi(value);
+        else if(strcmp(arg, "--pathfinder") == 0) {
+            if(strcmp(value, "astar") == 0) config.pathfinder = PATHFINDER_ASTAR;
+            else if(strcmp(value, "jps") == 0) config.pathfinder = PATHFINDER_JPS;
+            else if(strcmp(value, "hpa") == 0) config.pathfinder = PATHFINDER_HPA;
+            else {
+                fprintf(stderr, "unknown pathfinder %s\n", value);
+                return 1;
+            }
+        }
+        else if(strcmp(arg, "--steer-kernel") == 0) {
+            SteerKernel best = detect_steer_kernel();
+            if(strcmp(value, "scalar") == 0) config.steerkernel = STEER_SCALAR;
+            else if(strcmp(value, "sse") == 0) config.steerkernel = STEER_SSE;
+            else if(strcmp(value, "avx2") == 0) config.steerkernel = STEER_AVX2;
+            else {
+                fprintf(stderr, "unknown steer kernel %s\n", value);
+                return 1;
+            }
+            if(config.steerkernel > best) {
+                fprintf(stderr, "this cpu can only run steer kernels up to %s\n", steer_kernel_name(best));
+                return 1;
+            }
+        }
+        else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return 1;
+        }
+    }
+    if(config.width < 24 || config.height < 24) {
+        fprintf(stderr, "maps need to be at least 24x24\n");
+        return 1;
+    }
+
+    DungeonMap map = {0};
+    DungeonGenStats gen;
+    setup_bench(&map, &config, &gen);
+    u32 queued = map.minequeue.size();
+
+    std::vector<u64> ticktimes;
+    std::vector<u64> pathfinding;
+    std::vector<u64> separation;
+    std::vector<u64> steering;
+    std::vector<u64> orient;
+    ticktimes.reserve(config.ticks);
+    pathfinding.reserve(config.ticks);
+    separation.reserve(config.ticks);
+    steering.reserve(config.ticks);
+    orient.reserve(config.ticks);
+
+    u64 trace = 0xCBF29CE484222325ull;
+    u64 steered = 0; //units through steer_units, summed over ticks
+    u64 start = get_nanoseconds();
+    for(u32 tick = 0; tick < config.ticks; ++tick) {
+        u64 tickstart = get_nanoseconds();
+        simulate_tick(&map, SIM_DT);
+        ticktimes.push_back(get_nanoseconds() - tickstart);
+        pathfinding.push_back(map.profile.pathfinding);
+        separation.push_back(map.profile.separation);
+        steering.push_back(map.profile.steering);
+        orient.push_back(map.profile.orient);
+
+        u32 count = unit_count(&map.units);
+        steered += count;
+        trace = hash_bytes(trace, map.units.x.data(), sizeof(f32) * count);
+        trace = hash_bytes(trace, map.units.y.data(), sizeof(f32) * count);
+    }
+    f64 seconds = (get_nanoseconds() - start) / 1e9;
+    trace = hash_bytes(trace, map.map.grid, sizeof(i32) * map_cells(&map.map));
+
+    //stopping joins the workers, so the search totals are final after it
+    stop_path_service(&map.pathservice);
+    AccessTimes access;
+    time_map_access(&map.map, &access);
+
+    printf("{\n");
+    printf("  \"width\": %d, \"height\": %d, \"seed\": %u, \"imps\": %u, \"wanderers\": %u, \"mines\": %u, \"ticks\": %u,\n",
+           config.width, config.height, config.seed, config.imps, config.wanderers, queued, config.ticks);
+    printf("  \"pathfinder\": \"%s\", \"steer_kernel\": \"%s\",\n", pathfinder_name(config.pathfinder), steer_kernel_name(map.steerkernel));
+    printf("  \"gen_ms\": %.3f, \"gen_ms_per_megacell\": %.3f, \"gen_threads\": %u, \"rooms\": %u, \"caves\": %u, \"corridors\": %u,\n",
+           gen.seconds * 1000, gen.seconds * 1000 / ((f64)config.width * config.height / 1e6), gen.threads, gen.rooms, gen.caves, gen.corridors);
+    printf("  \"seconds\": %.4f, \"ticks_per_sec\": %.1f,\n", seconds, seconds > 0 ? config.ticks / seconds : 0);
+    printf("  \"tick_p50_ms\": %.4f, \"tick_p99_ms\": %.4f, \"tick_max_ms\": %.4f,\n",
+           percentile_ms(&ticktimes, 50), percentile_ms(&ticktimes, 99), percentile_ms(&ticktimes, 100));
+    printf("  \"systems\": {\n");
+    print_system("pathfinding", &pathfinding, false);
+    print_system("separation", &separation, false);
+    print_system("steering", &steering, false);
+    print_system("orient_tiles", &orient, true);
+    printf("  },\n");
+    f64 steerms = total_ms(&steering);
+    printf("  \"steer_units_per_ms\": %.1f, \"separation_units_per_ms\": %.1f,\n",
+           steerms > 0 ? steered / steerms : 0, total_ms(&separation) > 0 ? steered / total_ms(&separation) : 0);
+    printf("  \"access\": {\"rows_chunked_ms\": %.3f, \"rows_flat_ms\": %.3f, \"columns_chunked_ms\": %.3f, \"columns_flat_ms\": %.3f, \"orient_tiles_full_ms\": %.3f, \"checksum\": %lld},\n",
+           access.chunkedrows, access.flatrows, access.chunkedcolumns, access.flatcolumns, access.orient, (long long)access.checksum);
+    printf("  \"path_searches\": %u, \"path_search_ms\": %.3f,\n", map.pathservice.searches, map.pathservice.searchtime / 1e6);
+    printf("  \"mined\": %u, \"units\": %u, \"trace_hash\": \"%016llx\"\n", queued - (u32)map.minequeue.size(), unit_count(&map.units), (unsigned long long)trace);
+    printf("}\n");
+
+    dispose_flow_field(&map.mineflow);
+    dispose_map(&map.map);
+    return 0;
+}
@@ -0,0 +1,148 @@
+//checks the hierarchical pathfinder two ways on random maps, exiting non-zero
+//if either fails:
+//
+//  - HPA finds a path exactly when A* does, every path it returns is a real
+//    path over the map, and it costs at most MAX_DETOUR times what A*'s does
+//    plus two clusters' worth of steps. routing through entrances is what
+//    makes HPA paths longer, the bound is loose enough for that and tight
+//    enough to catch a hop refined against the wrong tile.
+//  - after random digs and fills, each followed by repair_cluster_graph, the
+//    graph matches one built from scratch on the same map, cluster for
+//    cluster, entrance for entrance and distance for distance.
+//
+//the Makefile builds it twice, once with DIAGONAL_ASTAR, like jps_check.
+//
+//  hpa_check [--seeds 300] [--queries 20] [--ticks 30]
+
+#include <vector>
+#include "core.h"
+#include "map.h"
+#include "hpa.h"
+#include "pathcheck.h"
+
+const f64 MAX_DETOUR = 1.5;
+const i32 DETOUR_SLACK = 2 * CLUSTER_SIZE * STRAIGHT_COST;
+
+static inline
+bool same_node(ClusterNode* a, ClusterNode* b) {
+    return a->x == b->x && a->y == b->y && a->partnerx == b->partnerx && a->partnery == b->partnery && a->neighbor == b->neighbor;
+}
+
+//the first cluster where the graphs differ, -1 if there is none
+static inline
+i32 first_different_cluster(ClusterGraph* a, ClusterGraph* b) {
+    if(a->width != b->width || a->height != b->height || a->clusters.size() != b->clusters.size())
+        return 0;
+    for(u32 i = 0; i < a->clusters.size(); ++i) {
+        Cluster* x = &a->clusters[i];
+        Cluster* y = &b->clusters[i];
+        if(x->x != y->x || x->y != y->y || x->width != y->width || x->height != y->height)
+            return i;
+        if(x->nodes.size() != y->nodes.size() || x->dist != y->dist)
+            return i;
+        for(u32 n = 0; n < x->nodes.size(); ++n)
+            if(!same_node(&x->nodes[n], &y->nodes[n]))
+                return i;
+    }
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    u32 seeds = 300;
+    u32 queries = 20;
+    u32 ticks = 30;
+    for(i32 i = 1; i + 1 < argc; i += 2) {
+        if(strcmp(argv[i], "--seeds") == 0) seeds = atoi(argv[i + 1]);
+        else if(strcmp(argv[i], "--queries") == 0) queries = atoi(argv[i + 1]);
+        else if(strcmp(argv[i], "--ticks") == 0) ticks = atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+#ifdef DIAGONAL_ASTAR
+    const char* moves = "diagonal";
+#else
+    const char* moves = "straight";
+#endif
+
+    std::vector<vec2> astar;
+    std::vector<vec2> hpa;
+    u32 searches = 0;
+    u32 found = 0;
+    u32 repairs = 0;
+    u32 failures = 0;
+    f64 worst = 1;
+    for(u32 seed = 1; seed <= seeds; ++seed) {
+        Rng rng;
+        seed_rng(&rng, seed);
+        Map map = random_map(seed, &rng);
+        ClusterGraph graph = {};
+
+        //searches after each round of changes go over the repaired graph
+        for(u32 tick = 0; tick <= ticks; ++tick) {
+            if(tick > 0) {
+                u32 changes = random_int(&rng, 1, 6);
+                for(u32 i = 0; i < changes; ++i) {
+                    i32 x = random_int(&rng, 0, map.width - 1);
+                    i32 y = random_int(&rng, 0, map.height - 1);
+                    set_tile(&map, x, y, random_int(&rng, 0, 3) == 0 ? GEN_WALL : GEN_FLOOR);
+                }
+                map.version++;
+                repair_cluster_graph(&graph, &map);
+                repairs++;
+
+                ClusterGraph fresh = {};
+                build_cluster_graph(&fresh, &map);
+                i32 cluster = first_different_cluster(&graph, &fresh);
+                if(cluster >= 0) {
+                    fprintf(stderr, "%s: seed %u tick %u, %dx%d map: repaired cluster %d differs from a fresh build\n",
+                            moves, seed, tick, map.width, map.height, cluster);
+                    failures++;
+                    break;
+                }
+            }
+
+            u32 count = tick == 0 ? queries : queries / 4;
+            for(u32 q = 0; q < count; ++q) {
+                vec2 start;
+                if(!random_floor(&map, &rng, &start))
+                    break;
+                vec2 dest = V2(random_int(&rng, 0, map.width - 1), random_int(&rng, 0, map.height - 1));
+
+                pathfind_astar(&map, start, dest, &astar);
+                pathfind_hpa(&graph, &map, start, dest, &hpa);
+                searches++;
+
+                bool astarfound = path_found(&astar, start, dest);
+                bool hpafound = path_found(&hpa, start, dest);
+                i32 astarcost = path_cost(&map, &astar, start, dest, astarfound);
+                i32 hpacost = path_cost(&map, &hpa, start, dest, hpafound);
+                if(astarfound)
+                    found++;
+                if(astarfound && hpafound && astarcost > 0)
+                    worst = std::max(worst, (f64)hpacost / astarcost);
+
+                const char* problem = NULL;
+                if(astarcost < 0) problem = "astar returned an invalid path";
+                else if(hpacost < 0) problem = "hpa returned an invalid path";
+                else if(astarfound != hpafound) problem = "only one of them found a path";
+                else if(hpacost < astarcost) problem = "hpa beat astar, so astar is not shortest";
+                else if(hpacost > astarcost * MAX_DETOUR + DETOUR_SLACK) problem = "hpa path is too long";
+
+                if(problem) {
+                    fprintf(stderr, "%s: seed %u tick %u query %u, %dx%d map, (%d, %d) to (%d, %d): %s (astar %d, hpa %d)\n",
+                            moves, seed, tick, q, map.width, map.height, (i32)start.x, (i32)start.y, (i32)dest.x, (i32)dest.y,
+                            problem, astarcost, hpacost);
+                    failures++;
+                }
+            }
+        }
+        dispose_map(&map);
+    }
+
+    printf("%s: %u seeds, %u searches, %u found, %u repairs, worst hpa/astar %.3f, %u failures\n",
+           moves, seeds, searches, found, repairs, worst, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+//sweeps seeds over random maps and checks that jump point search finds paths
+//of the same cost as A*, and that every path either one returns is a real
+//path over the map. exits non-zero if any search disagrees, so it
+//can sit in a build. the Makefile builds it twice, once with DIAGONAL_ASTAR,
+//so both move sets are covered.
+//
+//  jps_check [--seeds 2000] [--queries 20]
+
+#include <vector>
+#include "core.h"
+#include "map.h"
+#include "pathcheck.h"
+
+int main(int argc, char** argv) {
+    u32 seeds = 2000;
+    u32 queries = 20;
+    for(i32 i = 1; i + 1 < argc; i += 2) {
+        if(strcmp(argv[i], "--seeds") == 0) seeds = atoi(argv[i + 1]);
+        else if(strcmp(argv[i], "--queries") == 0) queries = atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+#ifdef DIAGONAL_ASTAR
+    const char* moves = "diagonal";
+#else
+    const char* moves = "straight";
+#endif
+
+    std::vector<vec2> astar;
+    std::vector<vec2> jps;
+    u32 searches = 0;
+    u32 found = 0;
+    u32 failures = 0;
+    for(u32 seed = 1; seed <= seeds; ++seed) {
+        Rng rng;
+        seed_rng(&rng, seed);
+        Map map = random_map(seed, &rng);
+
+        for(u32 q = 0; q < queries; ++q) {
+            vec2 start;
+            if(!random_floor(&map, &rng, &start))
+                break;
+            //any tile will do for dest, walls are how mining is asked for
+            vec2 dest = V2(random_int(&rng, 0, map.width - 1), random_int(&rng, 0, map.height - 1));
+
+            pathfind_astar(&map, start, dest, &astar);
+            pathfind_jps(&map, start, dest, &jps);
+            searches++;
+
+            bool astarfound = path_found(&astar, start, dest);
+            bool jpsfound = path_found(&jps, start, dest);
+            i32 astarcost = path_cost(&map, &astar, start, dest, astarfound);
+            i32 jpscost = path_cost(&map, &jps, start, dest, jpsfound);
+            if(astarfound)
+                found++;
+
+            const char* problem = NULL;
+            if(astarcost < 0) problem = "astar returned an invalid path";
+            else if(jpscost < 0) problem = "jps returned an invalid path";
+            else if(astarfound != jpsfound) problem = "only one of them found a path";
+            else if(astarcost != jpscost) problem = "path costs differ";
+
+            if(problem) {
+                fprintf(stderr, "%s: seed %u query %u, %dx%d map, (%d, %d) to (%d, %d): %s (astar %d, jps %d)\n",
+                        moves, seed, q, map.width, map.height, (i32)start.x, (i32)start.y, (i32)dest.x, (i32)dest.y,
+                        problem, astarcost, jpscost);
+                failures++;
+            }
+        }
+        dispose_map(&map);
+    }
+
+    printf("%s: %u seeds, %u searches, %u found, %u failures\n", moves, seeds, searches, found, failures);
+    return failures == 0 ? 0 : 1;
+}
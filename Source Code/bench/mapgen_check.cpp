@@ -0,0 +1,134 @@
+//checks generate_dungeon over many seeds and sizes, from maps too small for a
+//room to ones several regions across, exiting non-zero if any map breaks one
+//of its promises:
+//
+//  - stats.start is open floor whenever the map has any, and every open tile
+//    can be walked to from it.
+//  - 1, 3 and 8 threads build the same map, tile for tile, with the same
+//    stats.
+//  - the border is all wall, so nothing walks or paths off the map.
+//
+//  mapgen_check [--seeds 40]
+
+#include <vector>
+#include "core.h"
+#include "map.h"
+#include "mapgen.h"
+
+const u32 THREADS[] = {1, 3, 8};
+
+static inline
+u32 open_tiles(Map* map) {
+    u32 open = 0;
+    for(i32 y = 0; y < map->height; ++y)
+        for(i32 x = 0; x < map->width; ++x)
+            open += !tile_blocked(map, x, y);
+    return open;
+}
+
+//the open tiles that can't be walked to from start, every open tile if start
+//isn't open itself
+static inline
+u32 unreachable_tiles(Map* map, vec2 start) {
+    std::vector<u8> seen(map->width * map->height, 0);
+    std::vector<vec2> open;
+    if(start.x >= 0 && start.y >= 0 && start.x < map->width && start.y < map->height && !tile_blocked(map, start.x, start.y)) {
+        seen[(i32)start.x + (i32)start.y * map->width] = 1;
+        open.push_back(start);
+    }
+    for(u32 i = 0; i < open.size(); ++i) {
+        const i32 STEPS[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+        for(u32 s = 0; s < 4; ++s) {
+            i32 x = open[i].x + STEPS[s][0];
+            i32 y = open[i].y + STEPS[s][1];
+            if(x < 0 || y < 0 || x >= map->width || y >= map->height || seen[x + y * map->width] || tile_blocked(map, x, y))
+                continue;
+            seen[x + y * map->width] = 1;
+            open.push_back(V2(x, y));
+        }
+    }
+
+    return open_tiles(map) - open.size();
+}
+
+static inline
+u32 open_border_tiles(Map* map) {
+    u32 open = 0;
+    for(i32 y = 0; y < map->height; ++y)
+        for(i32 x = 0; x < map->width; ++x)
+            if(x == 0 || y == 0 || x == map->width - 1 || y == map->height - 1)
+                open += !tile_blocked(map, x, y);
+    return open;
+}
+
+static inline
+bool same_dungeon(Map* a, DungeonGenStats* astats, Map* b, DungeonGenStats* bstats) {
+    if(!(astats->start == bstats->start) || astats->regions != bstats->regions || astats->rooms != bstats->rooms ||
+       astats->caves != bstats->caves || astats->corridors != bstats->corridors)
+        return false;
+    for(i32 y = 0; y < a->height; ++y)
+        for(i32 x = 0; x < a->width; ++x)
+            if(get_tile(a, x, y) != get_tile(b, x, y))
+                return false;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    u32 seeds = 40;
+    for(i32 i = 1; i + 1 < argc; i += 2) {
+        if(strcmp(argv[i], "--seeds") == 0) seeds = atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    u32 maps = 0;
+    u32 floorless = 0;
+    u32 failures = 0;
+    for(u32 seed = 1; seed <= seeds; ++seed) {
+        Rng sizes;
+        seed_rng(&sizes, seed);
+        //tiny, one region, and a few regions with leftover strips
+        i32 dims[3][2] = {
+            {random_int(&sizes, 3, 24), random_int(&sizes, 3, 24)},
+            {random_int(&sizes, 24, 128), random_int(&sizes, 24, 128)},
+            {random_int(&sizes, 129, 400), random_int(&sizes, 129, 300)},
+        };
+        for(u32 d = 0; d < 3; ++d) {
+            Map first = {0};
+            DungeonGenStats firststats;
+            for(u32 t = 0; t < sizeof(THREADS) / sizeof(THREADS[0]); ++t) {
+                Rng rng;
+                seed_rng(&rng, seed);
+                DungeonGenStats stats;
+                Map map = generate_dungeon(dims[d][0], dims[d][1], THREADS[t], &rng, &stats);
+                maps++;
+
+                const char* problem = NULL;
+                bool anyfloor = open_tiles(&map) > 0;
+                if(anyfloor && unreachable_tiles(&map, stats.start) == open_tiles(&map)) problem = "start is not open floor";
+                else if(unreachable_tiles(&map, stats.start) > 0) problem = "some open tiles can't be reached from start";
+                else if(open_border_tiles(&map) > 0) problem = "the border has open tiles";
+                else if(t > 0 && !same_dungeon(&first, &firststats, &map, &stats)) problem = "the map changes with the thread count";
+                if(problem) {
+                    fprintf(stderr, "seed %u, %dx%d map on %u threads, start (%d, %d): %s\n",
+                            seed, map.width, map.height, THREADS[t], (i32)stats.start.x, (i32)stats.start.y, problem);
+                    failures++;
+                }
+                floorless += t == 0 && !anyfloor;
+
+                if(t == 0) {
+                    first = map;
+                    firststats = stats;
+                } else {
+                    dispose_map(&map);
+                }
+            }
+            dispose_map(&first);
+        }
+    }
+
+    printf("mapgen: %u maps, %u of %u layouts without floor, %u failures\n", maps, floorless, seeds * 3, failures);
+    return failures == 0 ? 0 : 1;
+}
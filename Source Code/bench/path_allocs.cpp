@@ -0,0 +1,176 @@
+//counts heap allocations made by the pathfinders. operator new and the malloc
+//family are replaced with counting versions, so std::vector growth and the
+//PathGrid arena both show up. each pathfinder runs the same queries twice:
+//the cold pass starts with no PathGrid and an empty path vector, the warm
+//pass reuses both. exits non-zero if a warm A* or JPS search allocates.
+//
+//  path_allocs [--width 100] [--height 90] [--seed 1] [--queries 200]
+
+#include <new>
+#include <vector>
+#include "core.h"
+#include "map.h"
+#include "mapgen.h"
+#include "hpa.h"
+
+//
+//   COUNTING ALLOCATOR
+//
+
+//glibc's own entry points, so the replacements below can forward to them
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void __libc_free(void* ptr);
+
+static u64 allocations = 0;
+
+extern "C" void* malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+void* operator new(size_t size) {
+    allocations++;
+    void* ptr = __libc_malloc(size ? size : 1);
+    if(ptr == NULL)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    __libc_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    __libc_free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    __libc_free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    __libc_free(ptr);
+}
+
+//
+//   BENCH
+//
+
+struct PassResult {
+    u64 allocations;
+    f64 ms;
+    u32 found;
+};
+
+static inline
+vec2 random_open_tile(Map* map, Rng* rng) {
+    for(;;) {
+        i32 x = random_int(rng, 1, map->width - 2);
+        i32 y = random_int(rng, 1, map->height - 2);
+        if(!tile_blocked(map, x, y))
+            return V2(x, y);
+    }
+}
+
+static inline
+PassResult run_pass(Map* map, ClusterGraph* graph, Pathfinder pathfinder, std::vector<vec2>* starts, std::vector<vec2>* dests, std::vector<vec2>* path) {
+    PassResult result = {0};
+    u64 before = allocations;
+    u64 begin = get_nanoseconds();
+    for(u32 i = 0; i < starts->size(); ++i) {
+        switch(pathfinder) {
+            case PATHFINDER_ASTAR: pathfind_astar(map, (*starts)[i], (*dests)[i], path); break;
+            case PATHFINDER_JPS: pathfind_jps(map, (*starts)[i], (*dests)[i], path); break;
+            case PATHFINDER_HPA: pathfind_hpa(graph, map, (*starts)[i], (*dests)[i], path); break;
+        }
+        result.found += path->size() > 1;
+    }
+    result.ms = (get_nanoseconds() - begin) / 1e6;
+    result.allocations = allocations - before;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    i32 width = 100;
+    i32 height = 90;
+    u32 seed = 1;
+    u32 queries = 200;
+    for(i32 i = 1; i + 1 < argc; i += 2) {
+        const char* arg = argv[i];
+        const char* value = argv[i + 1];
+        if(strcmp(arg, "--width") == 0) width = atoi(value);
+        else if(strcmp(arg, "--height") == 0) height = atoi(value);
+        else if(strcmp(arg, "--seed") == 0) seed = strtoul(value, NULL, 10);
+        else if(strcmp(arg, "--queries") == 0) queries = atoi(value);
+        else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return 1;
+        }
+    }
+    if(width < 24 || height < 24) {
+        fprintf(stderr, "maps need to be at least 24x24\n");
+        return 1;
+    }
+
+    Rng rng;
+    seed_rng(&rng, seed);
+    DungeonGenStats gen;
+    Map map = generate_dungeon(width, height, 1, &rng, &gen);
+
+    std::vector<vec2> starts;
+    std::vector<vec2> dests;
+    for(u32 i = 0; i < queries; ++i) {
+        starts.push_back(random_open_tile(&map, &rng));
+        dests.push_back(random_open_tile(&map, &rng));
+    }
+
+    const char* names[] = {"astar", "jps", "hpa"};
+    const Pathfinder pathfinders[] = {PATHFINDER_ASTAR, PATHFINDER_JPS, PATHFINDER_HPA};
+    bool failed = false;
+
+    printf("{\n");
+    printf("  \"width\": %d, \"height\": %d, \"seed\": %u, \"queries\": %u,\n", width, height, seed, queries);
+    for(u32 i = 0; i < 3; ++i) {
+        //start every pathfinder from nothing, the way the game's first search does
+        if(map.paths != NULL) {
+            dispose_path_grid(map.paths);
+            map.paths = NULL;
+        }
+        ClusterGraph graph = {};
+        std::vector<vec2> path;
+        PassResult cold = run_pass(&map, &graph, pathfinders[i], &starts, &dests, &path);
+        PassResult warm = run_pass(&map, &graph, pathfinders[i], &starts, &dests, &path);
+        if(pathfinders[i] != PATHFINDER_HPA && warm.allocations > 0)
+            failed = true;
+
+        printf("  \"%s\": {\"cold_allocs\": %llu, \"cold_ms\": %.3f, \"warm_allocs\": %llu, \"warm_allocs_per_search\": %.3f, \"warm_ms\": %.3f, \"warm_us_per_search\": %.2f, \"found\": %u}%s\n",
+               names[i], (unsigned long long)cold.allocations, cold.ms, (unsigned long long)warm.allocations,
+               (f64)warm.allocations / queries, warm.ms, warm.ms * 1000 / queries, warm.found, i + 1 < 3 ? "," : "");
+    }
+    printf("}\n");
+
+    dispose_map(&map);
+    if(failed)
+        fprintf(stderr, "a warm A* or JPS search allocated\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+#ifndef PATHCHECK_H
+#define PATHCHECK_H
+
+#include <vector>
+#include "core.h"
+#include "map.h"
+#include "mapgen.h"
+
+//what the pathfinder checks share: random maps to search over, and a way to
+//tell whether a path is one the pathfinders may return and what it costs.
+
+//cost of one step from a to b, or -1 if the pathfinders may not make it.
+//dest counts as open, the same as in path_walkable.
+static inline
+i32 step_cost(Map* map, vec2 a, vec2 b, vec2 dest) {
+    i32 dx = (i32)b.x - (i32)a.x;
+    i32 dy = (i32)b.y - (i32)a.y;
+    if(abs(dx) > 1 || abs(dy) > 1 || (dx == 0 && dy == 0))
+        return -1;
+    if(dx == 0 || dy == 0)
+        return STRAIGHT_COST;
+    //a diagonal may not cut the corner of a blocked tile
+    vec2 side = V2(b.x - dx, b.y);
+    vec2 other = V2(b.x, b.y - dy);
+    if((tile_blocked(map, side.x, side.y) && !(side == dest)) || (tile_blocked(map, other.x, other.y) && !(other == dest)))
+        return -1;
+#ifdef DIAGONAL_ASTAR
+    return DIAGONAL_COST;
+#else
+    return -1;
+#endif
+}
+
+//cost of reaching dest along a path as the pathfinders store it, dest first
+//and start last. a path to a wall stops next to it, the step onto the wall
+//still counts, it is the one a diagonal or straight approach differs by.
+//returns -1 if the path is not one the pathfinders are allowed to return.
+static inline
+i32 path_cost(Map* map, std::vector<vec2>* path, vec2 start, vec2 dest, bool found) {
+    if(path->size() == 0 || !(path->back() == start))
+        return -1;
+    i32 cost = 0;
+    for(u32 i = 0; i < path->size(); ++i) {
+        vec2 tile = (*path)[i];
+        //the start tile is where the unit already stands
+        if(i + 1 < path->size() && tile_blocked(map, tile.x, tile.y))
+            return -1;
+        if(i == 0)
+            continue;
+        i32 step = step_cost(map, tile, (*path)[i - 1], dest);
+        if(step < 0)
+            return -1;
+        cost += step;
+    }
+    if(found && !((*path)[0] == dest)) {
+        if(!tile_blocked(map, dest.x, dest.y))
+            return -1;
+        i32 step = step_cost(map, (*path)[0], dest, dest);
+        if(step < 0)
+            return -1;
+        cost += step;
+    }
+    return cost;
+}
+
+//the pathfinders give back just the start when there is no way through
+static inline
+bool path_found(std::vector<vec2>* path, vec2 start, vec2 dest) {
+    return path->size() > 1 || start == dest || path->size() == 0 || !((*path)[0] == start);
+}
+
+//open noise on small maps finds more corner cases than the generator does,
+//every eighth seed takes a generated dungeon instead
+static inline
+Map random_map(u32 seed, Rng* rng) {
+    if(seed % 8 == 7) {
+        DungeonGenStats stats;
+        return generate_dungeon(random_int(rng, 24, 96), random_int(rng, 24, 96), 1, rng, &stats);
+    }
+    i32 width = random_int(rng, 4, 48);
+    i32 height = random_int(rng, 4, 48);
+    i32 open = random_int(rng, 40, 85);
+    Map map = create_map(width, height, GEN_WALL);
+    for(i32 y = 0; y < height; ++y) {
+        for(i32 x = 0; x < width; ++x) {
+            if(random_int(rng, 0, 99) < open)
+                set_tile(&map, x, y, GEN_FLOOR);
+        }
+    }
+    return map;
+}
+
+static inline
+bool random_floor(Map* map, Rng* rng, vec2* tile) {
+    for(u32 tries = 0; tries < 1000; ++tries) {
+        i32 x = random_int(rng, 0, map->width - 1);
+        i32 y = random_int(rng, 0, map->height - 1);
+        if(!tile_blocked(map, x, y)) {
+            *tile = V2(x, y);
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif
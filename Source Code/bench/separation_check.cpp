@@ -0,0 +1,194 @@
+//checks calculate_seperation over the unit hash against a brute force pass
+//that pushes every unit away from every other one, and query_unit_hash
+//against the same scan. units are scattered over the open floor of generated
+//dungeons, some spread out and some piled into a few tiles, some stacked on
+//one point and some on tile corners, in crowds from one unit to thousands so
+//the hash's rows wrap around its table too. exits non-zero if a push or a
+//neighbor count disagrees.
+//
+//it then times a tick's worth of separation for --units units on a --size
+//map, the hash rebuild and one calculate_seperation per unit, and prints the
+//median and best of the runs. that is meant to stay under a millisecond on
+//one core, but the timing is only reported, it does not fail the check.
+//
+//  separation_check [--seeds 20] [--units 5000] [--size 256] [--seed 1]
+//                   [--runs 50]
+
+#include <vector>
+#include <algorithm>
+#include "core.h"
+#include "map.h"
+#include "mapgen.h"
+
+//summing in a different order moves the last few bits, nothing more
+const f32 PUSH_TOLERANCE = 1e-4f;
+
+//calculate_seperation as it would be without the hash, every unit against
+//every other one
+static inline
+vec2 reference_seperation(Map* map, f32* x, f32* y, u32 count, vec2 pos) {
+    vec2 total = {0};
+    for(u32 i = 0; i < count; ++i) {
+        vec2 push = pos - V2(x[i], y[i]);
+        if(push.x * push.x + push.y * push.y < MIN_SEPERATION * MIN_SEPERATION)
+            total = total + (push/14.0f);
+    }
+
+    i32 tx = pos.x / TILE_SIZE;
+    i32 ty = pos.y / TILE_SIZE;
+    for(i32 wx = tx - 1; wx < tx + 1; ++wx) {
+        for(i32 wy = ty - 1; wy < ty + 1; ++wy) {
+            if(wx < 0 || wy < 0 || wx >= map->width || wy >= map->height || !tile_blocked(map, wx, wy))
+                continue;
+            f32 dist = getDistanceE(pos.x, pos.y, wx * TILE_SIZE, wy * TILE_SIZE);
+            if(dist <= TILE_SIZE-2 && dist >= 0) {
+                vec2 push = pos - V2(wx * TILE_SIZE, wy * TILE_SIZE);
+                total = total + (push/8.5);
+            }
+        }
+    }
+    return MAX_FORCE * total;
+}
+
+static inline
+vec2 random_open_tile(Map* map, Rng* rng) {
+    for(;;) {
+        i32 x = random_int(rng, 1, map->width - 2);
+        i32 y = random_int(rng, 1, map->height - 2);
+        if(!tile_blocked(map, x, y))
+            return V2(x, y);
+    }
+}
+
+//count units somewhere on the open floor. a pile puts them all within a few
+//tiles of one spot, and every so often a unit lands on a tile corner or on
+//top of the unit before it.
+static inline
+void place_units(Map* map, Rng* rng, u32 count, bool pile, std::vector<f32>* x, std::vector<f32>* y) {
+    x->resize(count);
+    y->resize(count);
+    vec2 spot = random_open_tile(map, rng);
+    for(u32 i = 0; i < count; ++i) {
+        vec2 tile = random_open_tile(map, rng);
+        if(pile) {
+            tile.x = std::min(std::max(spot.x + random_int(rng, -2, 2), 0.0f), map->width - 1.0f);
+            tile.y = std::min(std::max(spot.y + random_int(rng, -2, 2), 0.0f), map->height - 1.0f);
+        }
+        (*x)[i] = tile.x * TILE_SIZE + random_int(rng, 0, TILE_SIZE * 8 - 1) / 8.0f;
+        (*y)[i] = tile.y * TILE_SIZE + random_int(rng, 0, TILE_SIZE * 8 - 1) / 8.0f;
+        u32 roll = random_int(rng, 0, 15);
+        if(roll == 0) {
+            (*x)[i] = tile.x * TILE_SIZE;
+            (*y)[i] = tile.y * TILE_SIZE;
+        } else if(roll == 1 && i > 0) {
+            (*x)[i] = (*x)[i - 1];
+            (*y)[i] = (*y)[i - 1];
+        }
+    }
+}
+
+//the number of pushes and neighbor counts that disagree
+static inline
+u32 check_units(Map* map, UnitHash* hash, f32* x, f32* y, u32 count, const char* label) {
+    build_unit_hash(hash, x, y, count);
+    std::vector<u32> near;
+    u32 failures = 0;
+    for(u32 i = 0; i < count && failures < 10; ++i) {
+        vec2 pos = V2(x[i], y[i]);
+        vec2 got = calculate_seperation(map, hash, pos);
+        vec2 want = reference_seperation(map, x, y, count, pos);
+        f32 scale = 1 + fabsf(want.x) + fabsf(want.y);
+        if(fabsf(got.x - want.x) > PUSH_TOLERANCE * scale || fabsf(got.y - want.y) > PUSH_TOLERANCE * scale) {
+            fprintf(stderr, "%s, unit %u of %u at (%.3f, %.3f): pushed (%f, %f), brute force (%f, %f)\n",
+                    label, i, count, pos.x, pos.y, got.x, got.y, want.x, want.y);
+            failures++;
+        }
+
+        query_unit_hash(hash, pos, MIN_SEPERATION, &near);
+        u32 within = 0;
+        for(u32 j = 0; j < count; ++j) {
+            vec2 d = V2(x[j], y[j]) - pos;
+            within += d.x * d.x + d.y * d.y < MIN_SEPERATION * MIN_SEPERATION;
+        }
+        if(near.size() != within) {
+            fprintf(stderr, "%s, unit %u of %u at (%.3f, %.3f): query found %u units within %.0f, brute force %u\n",
+                    label, i, count, pos.x, pos.y, (u32)near.size(), MIN_SEPERATION, within);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    u32 seeds = 20;
+    u32 count = 5000;
+    i32 size = 256;
+    u32 seed = 1;
+    u32 runs = 50;
+    for(i32 i = 1; i + 1 < argc; i += 2) {
+        const char* arg = argv[i];
+        const char* value = argv[i + 1];
+        if(strcmp(arg, "--seeds") == 0) seeds = atoi(value);
+        else if(strcmp(arg, "--units") == 0) count = atoi(value);
+        else if(strcmp(arg, "--size") == 0) size = atoi(value);
+        else if(strcmp(arg, "--seed") == 0) seed = strtoul(value, NULL, 10);
+        else if(strcmp(arg, "--runs") == 0) runs = atoi(value);
+        else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return 1;
+        }
+    }
+    if(size < 24 || runs == 0) {
+        fprintf(stderr, "maps need to be at least 24x24, and runs at least 1\n");
+        return 1;
+    }
+
+    const u32 CROWDS[] = {1, 2, 7, 40, 300, 2000};
+    UnitHash hash;
+    std::vector<f32> x;
+    std::vector<f32> y;
+    u32 checked = 0;
+    u32 failures = 0;
+    for(u32 s = 1; s <= seeds && failures == 0; ++s) {
+        Rng rng;
+        seed_rng(&rng, s);
+        DungeonGenStats gen;
+        Map map = generate_dungeon(random_int(&rng, 24, 96), random_int(&rng, 24, 96), 1, &rng, &gen);
+        for(u32 c = 0; c < sizeof(CROWDS) / sizeof(CROWDS[0]) && failures == 0; ++c) {
+            for(u32 pile = 0; pile < 2 && failures == 0; ++pile) {
+                char label[64];
+                snprintf(label, sizeof(label), "seed %u, %s of %u", s, pile ? "pile" : "spread", CROWDS[c]);
+                place_units(&map, &rng, CROWDS[c], pile, &x, &y);
+                failures += check_units(&map, &hash, x.data(), y.data(), CROWDS[c], label);
+                checked += CROWDS[c];
+            }
+        }
+        dispose_map(&map);
+    }
+
+    Rng rng;
+    seed_rng(&rng, seed);
+    DungeonGenStats gen;
+    Map map = generate_dungeon(size, size, 1, &rng, &gen);
+    place_units(&map, &rng, count, false, &x, &y);
+
+    std::vector<u64> times;
+    f64 pushed = 0; //summed size of every push, so none of it is optimized out
+    for(u32 run = 0; run < runs; ++run) {
+        u64 start = get_nanoseconds();
+        build_unit_hash(&hash, x.data(), y.data(), count);
+        for(u32 i = 0; i < count; ++i) {
+            vec2 push = calculate_seperation(&map, &hash, V2(x[i], y[i]));
+            pushed += fabsf(push.x) + fabsf(push.y);
+        }
+        times.push_back(get_nanoseconds() - start);
+    }
+    std::sort(times.begin(), times.end());
+    f64 median = times[times.size() / 2] / 1e6;
+    f64 best = times[0] / 1e6;
+    dispose_map(&map);
+
+    printf("separation: %u units checked against brute force, %u failures; %u units on %dx%d, median %.3f ms, best %.3f ms, pushed %.1f\n",
+           checked, failures, count, size, size, median, best, pushed / runs);
+    return failures == 0 ? 0 : 1;
+}
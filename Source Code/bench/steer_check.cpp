@@ -0,0 +1,97 @@
+//checks that every steer kernel this cpu can run moves units exactly like
+//steer_units_scalar. each kernel gets its own copy of the same units and
+//inputs and runs the same ticks, then position, velocity and force have to
+//match the scalar run bit for bit. crowd sizes cover the vector tails, and
+//the units include ones sitting on their target, standing still, pushed far
+//past the force cap and not seeking at all. exits non-zero on any difference.
+//
+//  steer_check [--seeds 200] [--ticks 20]
+
+#include <vector>
+#include <string.h>
+#include "core.h"
+#include "steering.h"
+
+static inline
+f32 random_f32(Rng* rng, i32 lo, i32 hi) {
+    return random_int(rng, lo * 64, hi * 64) / 64.0f;
+}
+
+static inline
+void random_units(Rng* rng, u32 count, UnitStore* units, SteerInputs* in) {
+    *units = {};
+    resize_steer_inputs(in, count);
+    for(u32 i = 0; i < count; ++i) {
+        Unit unit = {0};
+        vec2 pos = V2(random_f32(rng, 0, 3000), random_f32(rng, 0, 3000));
+        u32 slot = unit_slot(units, spawn_unit(units, pos, &unit));
+        u32 kind = random_int(rng, 0, 7);
+        if(kind != 0) {
+            units->vx[slot] = random_f32(rng, -4, 4);
+            units->vy[slot] = random_f32(rng, -4, 4);
+            units->fx[slot] = random_f32(rng, -2, 2);
+            units->fy[slot] = random_f32(rng, -2, 2);
+        }
+        in->tx[i] = kind == 1 ? pos.x : random_f32(rng, 0, 3000);
+        in->ty[i] = kind == 1 ? pos.y : random_f32(rng, 0, 3000);
+        in->sx[i] = kind == 2 ? random_f32(rng, -500, 500) : random_f32(rng, -1, 1);
+        in->sy[i] = kind == 2 ? random_f32(rng, -500, 500) : random_f32(rng, -1, 1);
+        in->seeking[i] = kind == 3 ? 0 : -1;
+    }
+}
+
+static inline
+bool same_bits(std::vector<f32>* a, std::vector<f32>* b) {
+    return a->size() == b->size() && memcmp(a->data(), b->data(), a->size() * sizeof(f32)) == 0;
+}
+
+int main(int argc, char** argv) {
+    u32 seeds = 200;
+    u32 ticks = 20;
+    for(i32 i = 1; i + 1 < argc; i += 2) {
+        if(strcmp(argv[i], "--seeds") == 0) seeds = atoi(argv[i + 1]);
+        else if(strcmp(argv[i], "--ticks") == 0) ticks = atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    const f32 STEPS[] = {1.0f, 0.5f, 2.5f};
+    SteerKernel best = detect_steer_kernel();
+    UnitStore scalar;
+    UnitStore vector;
+    SteerInputs in;
+    u32 runs = 0;
+    u32 failures = 0;
+    for(u32 kernel = STEER_SCALAR + 1; kernel <= (u32)best; ++kernel) {
+        for(u32 seed = 1; seed <= seeds; ++seed) {
+            Rng rng;
+            seed_rng(&rng, seed);
+            u32 count = seed <= 40 ? seed - 1 : random_int(&rng, 40, 2000);
+            f32 step = STEPS[seed % 3];
+            random_units(&rng, count, &scalar, &in);
+            vector = scalar;
+
+            u32 tick = 0;
+            for(; tick < ticks; ++tick) {
+                steer_units(&scalar, &in, STEER_SCALAR, step);
+                steer_units(&vector, &in, (SteerKernel)kernel, step);
+                if(!same_bits(&scalar.x, &vector.x) || !same_bits(&scalar.y, &vector.y) ||
+                   !same_bits(&scalar.vx, &vector.vx) || !same_bits(&scalar.vy, &vector.vy) ||
+                   !same_bits(&scalar.fx, &vector.fx) || !same_bits(&scalar.fy, &vector.fy))
+                    break;
+            }
+            runs++;
+            if(tick < ticks) {
+                fprintf(stderr, "%s: seed %u, %u units, step %.1f: differs from scalar after tick %u\n",
+                        steer_kernel_name((SteerKernel)kernel), seed, count, step, tick);
+                failures++;
+            }
+        }
+    }
+
+    printf("steer: kernels up to %s checked against scalar, %u runs of %u ticks, %u failures\n",
+           steer_kernel_name(best), runs, ticks, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,287 @@
+//checks the unit store two ways, exiting non-zero if either fails:
+//
+//  - random spawns, removes, path sets and pops against a plain model of
+//    the same units. every live handle has to find its own unit, position,
+//    stats and path, every removed one has to find nothing, even once its
+//    index has been handed out again, and the path pool has to account for
+//    every point, live or garbage, through each compaction.
+//  - the dungeon asking the path service for wander paths while units are
+//    swap-removed mid-search and new ones spawned, and tiles dug, every few
+//    ticks. a path handed to a unit has to start on that unit's own tile
+//    and step tile by tile around the walls of the map it was applied to,
+//    and the results for units that left are dropped rather than handed to
+//    whoever took their slot. it runs once for each pathfinder.
+//
+//  unitstore_check [--ops 200000] [--ticks 3000] [--seed 1]
+
+#include <vector>
+#include <algorithm>
+#include "core.h"
+#include "map.h"
+#include "mapgen.h"
+#include "dungeonsim.h"
+
+struct ModelUnit {
+    UnitHandle handle;
+    vec2 pos;
+    i32 hp;
+    std::vector<vec2> path;
+};
+
+//live spans don't overlap, and their stretches plus the garbage are the
+//whole pool. false if the pool lost track of a point.
+static inline
+bool path_pool_consistent(UnitStore* units) {
+    std::vector<PathSpan> spans(units->paths.begin(), units->paths.end());
+    std::sort(spans.begin(), spans.end(), [](const PathSpan& a, const PathSpan& b) { return a.offset < b.offset; });
+    u32 owned = 0;
+    u32 end = 0;
+    for(u32 i = 0; i < spans.size(); ++i) {
+        if(spans[i].count > spans[i].capacity || (spans[i].capacity > 0 && spans[i].offset < end))
+            return false;
+        if(spans[i].capacity > 0)
+            end = spans[i].offset + spans[i].capacity;
+        owned += spans[i].capacity;
+    }
+    return end <= units->pathpool.points.size() && owned + units->pathpool.garbage == units->pathpool.points.size();
+}
+
+//the number of units whose handle, slot, stats or path disagree with the model
+static inline
+u32 compare_with_model(UnitStore* units, std::vector<ModelUnit>* model, std::vector<UnitHandle>* dead) {
+    u32 mismatches = 0;
+    if(unit_count(units) != model->size())
+        mismatches++;
+    for(u32 i = 0; i < model->size(); ++i) {
+        ModelUnit* m = &(*model)[i];
+        u32 slot = unit_slot(units, m->handle);
+        if(slot == NO_UNIT || units->handles[slot] != m->handle || units->info[slot].hp != m->hp || !(unit_pos(units, slot) == m->pos)) {
+            mismatches++;
+            continue;
+        }
+        PathSpan* span = &units->paths[slot];
+        if(span->count != m->path.size()) {
+            mismatches++;
+            continue;
+        }
+        for(u32 p = 0; p < span->count; ++p) {
+            if(!(units->pathpool.points[span->offset + p] == m->path[p])) {
+                mismatches++;
+                break;
+            }
+        }
+    }
+    for(u32 i = 0; i < dead->size(); ++i)
+        if(unit_slot(units, (*dead)[i]) != NO_UNIT)
+            mismatches++;
+    return mismatches;
+}
+
+static inline
+u32 check_store_model(u32 ops, u32 seed) {
+    Rng rng;
+    seed_rng(&rng, seed);
+    UnitStore units = {};
+    std::vector<ModelUnit> model;
+    std::vector<UnitHandle> dead; //the most recently removed, a handle's reuse count only runs to 4095
+    std::vector<vec2> path;
+    u32 failures = 0;
+    u32 compactions = 0;
+    u32 reused = 0;
+
+    for(u32 op = 0; op < ops && failures == 0; ++op) {
+        u32 kind = random_int(&rng, 0, 9);
+        //every so often most of the crowd leaves at once, so indices get reused in bulk
+        if(op % 20000 == 10000) {
+            while(model.size() > 8) {
+                u32 pick = random_int(&rng, 0, model.size() - 1);
+                remove_unit(&units, model[pick].handle);
+                dead.push_back(model[pick].handle);
+                model[pick] = model.back();
+                model.pop_back();
+            }
+        } else if(kind < 3 || model.size() == 0) {
+            Unit unit = {0};
+            unit.hp = random_int(&rng, 0, 999);
+            vec2 pos = V2(random_int(&rng, 0, 499), random_int(&rng, 0, 499));
+            bool fresh = units.freehandles.size() == 0;
+            ModelUnit m;
+            m.handle = spawn_unit(&units, pos, &unit);
+            m.pos = pos;
+            m.hp = unit.hp;
+            model.push_back(m);
+            reused += !fresh;
+        } else {
+            u32 pick = random_int(&rng, 0, model.size() - 1);
+            ModelUnit* m = &model[pick];
+            u32 slot = unit_slot(&units, m->handle);
+            if(slot == NO_UNIT) {
+                failures++;
+                break;
+            }
+            if(kind < 6) {
+                remove_unit(&units, m->handle);
+                dead.push_back(m->handle);
+                model[pick] = model.back();
+                model.pop_back();
+            } else if(kind < 9) {
+                path.resize(random_int(&rng, 0, 40));
+                for(u32 p = 0; p < path.size(); ++p)
+                    path[p] = V2(random_int(&rng, 0, 99), random_int(&rng, 0, 99));
+                set_path(&units.pathpool, &units.paths[slot], &path);
+                m->path = path;
+            } else if(units.paths[slot].count > 0) {
+                pop_path(&units.paths[slot]);
+                m->path.pop_back();
+            }
+        }
+        if(dead.size() > 2000)
+            dead.erase(dead.begin(), dead.begin() + 1000);
+
+        u32 garbage = units.pathpool.garbage;
+        tidy_unit_paths(&units);
+        compactions += units.pathpool.garbage < garbage;
+        if(!path_pool_consistent(&units)) {
+            fprintf(stderr, "store: op %u, the path pool lost track of a point\n", op);
+            failures++;
+        }
+        if(op % 97 == 0 || op + 1 == ops) {
+            u32 mismatches = compare_with_model(&units, &model, &dead);
+            if(mismatches > 0) {
+                fprintf(stderr, "store: op %u, %u units disagree with the model\n", op, mismatches);
+                failures++;
+            }
+        }
+    }
+
+    printf("store: %u ops, %u live units, %u handles reused, %u compactions, %u failures\n",
+           ops, (u32)model.size(), reused, compactions, failures);
+    return failures;
+}
+
+static inline
+vec2 random_open_tile(Map* map, Rng* rng) {
+    for(;;) {
+        i32 x = random_int(rng, 1, map->width - 2);
+        i32 y = random_int(rng, 1, map->height - 2);
+        if(!tile_blocked(map, x, y))
+            return V2(x, y);
+    }
+}
+
+//wander requests, apply_path_results and swap-removes together. units jump
+//straight to the end of each path they get, so a unit's tile is still the
+//one its search started from when the next result comes back.
+static inline
+u32 check_service_round_trip(Pathfinder pathfinder, u32 ticks, u32 seed) {
+    DungeonMap dungeon = {0};
+    seed_rng(&dungeon.rng, seed);
+    dungeon.map = create_map(100, 90, GEN_WALL);
+    for(i32 y = 1; y < 89; ++y)
+        for(i32 x = 1; x < 99; ++x)
+            if(random_int(&dungeon.rng, 0, 99) < 70)
+                set_tile(&dungeon.map, x, y, GEN_FLOOR);
+    orient_tiles(&dungeon.map);
+    dungeon.pathfinder = pathfinder;
+    start_path_service(&dungeon.pathservice, 4, true);
+
+    Unit unit = {0};
+    unit.type = UNIT_ORC;
+    for(u32 i = 0; i < 64; ++i)
+        spawn_unit(&dungeon.units, random_open_tile(&dungeon.map, &dungeon.rng) * TILE_SIZE, &unit);
+
+    UnitStore* units = &dungeon.units;
+    u32 requested = 0;
+    u32 applied = 0;
+    u32 dropped = 0;
+    u32 bad = 0;
+    for(u32 tick = 0; tick < ticks; ++tick) {
+        apply_path_results(&dungeon);
+        for(u32 i = 0; i < dungeon.pathresults.size(); ++i)
+            dropped += unit_slot(units, dungeon.pathresults[i].unit) == NO_UNIT;
+
+        for(u32 i = 0; i < unit_count(units); ++i) {
+            Unit* info = &units->info[i];
+            PathSpan* span = &units->paths[i];
+            if(info->state == UNIT_WALKING && span->count > 0) {
+                applied++;
+                vec2 start = V2((i32)(units->x[i] / TILE_SIZE), (i32)(units->y[i] / TILE_SIZE));
+                vec2* points = &units->pathpool.points[span->offset];
+                bool ok = points[span->count - 1] == start;
+                for(u32 p = 0; p + 1 < span->count; ++p) {
+                    i32 dx = abs((i32)points[p].x - (i32)points[p + 1].x);
+                    i32 dy = abs((i32)points[p].y - (i32)points[p + 1].y);
+                    if(std::max(dx, dy) != 1 || tile_blocked(&dungeon.map, points[p].x, points[p].y))
+                        ok = false;
+                }
+                if(!ok) {
+                    fprintf(stderr, "service: tick %u, unit %u at (%d, %d) got a path that is not its own or goes through a wall\n",
+                            tick, i, (i32)start.x, (i32)start.y);
+                    bad++;
+                }
+                units->x[i] = points[0].x * TILE_SIZE;
+                units->y[i] = points[0].y * TILE_SIZE;
+                clear_path(span);
+                info->state = UNIT_IDLE;
+            }
+            if(info->state == UNIT_IDLE) {
+                update_units(&dungeon, i);
+                requested += units->info[i].state == UNIT_WAITING;
+            }
+        }
+
+        //units leave and new ones arrive while their searches are in flight
+        if(tick % 5 == 0) {
+            u32 leaving = random_int(&dungeon.rng, 0, unit_count(units) - 1);
+            for(u32 i = 0; i < unit_count(units); ++i) {
+                u32 slot = (leaving + i) % unit_count(units);
+                if(units->info[slot].state == UNIT_WAITING) {
+                    leaving = slot;
+                    break;
+                }
+            }
+            remove_unit(units, units->handles[leaving]);
+            unit.type = UNIT_DEMON;
+            spawn_unit(units, random_open_tile(&dungeon.map, &dungeon.rng) * TILE_SIZE, &unit);
+        }
+        if(tick % 7 == 0) {
+            vec2 tile = V2(random_int(&dungeon.rng, 1, 98), random_int(&dungeon.rng, 1, 88));
+            dig_tile(&dungeon, tile, random_int(&dungeon.rng, 0, 1) ? GEN_FLOOR : GEN_WALL);
+            orient_dirty_tiles(&dungeon);
+        }
+        tidy_unit_paths(units);
+    }
+    stop_path_service(&dungeon.pathservice);
+
+    const char* names[] = {"astar", "jps", "hpa"};
+    printf("service %s: %u ticks, %u requested, %u applied, %u dropped for units that left, %u bad\n",
+           names[pathfinder], ticks, requested, applied, dropped, bad);
+    dispose_flow_field(&dungeon.mineflow);
+    dispose_map(&dungeon.map);
+    if(applied == 0 || dropped == 0) {
+        fprintf(stderr, "service %s: the round trip never applied a path or never dropped one\n", names[pathfinder]);
+        bad++;
+    }
+    return bad;
+}
+
+int main(int argc, char** argv) {
+    u32 ops = 200000;
+    u32 ticks = 3000;
+    u32 seed = 1;
+    for(i32 i = 1; i + 1 < argc; i += 2) {
+        if(strcmp(argv[i], "--ops") == 0) ops = atoi(argv[i + 1]);
+        else if(strcmp(argv[i], "--ticks") == 0) ticks = atoi(argv[i + 1]);
+        else if(strcmp(argv[i], "--seed") == 0) seed = strtoul(argv[i + 1], NULL, 10);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    u32 failures = check_store_model(ops, seed);
+    failures += check_service_round_trip(PATHFINDER_ASTAR, ticks, seed);
+    failures += check_service_round_trip(PATHFINDER_JPS, ticks, seed);
+    failures += check_service_round_trip(PATHFINDER_HPA, ticks, seed);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,283 @@
+///////////////////////////////////////////////////////////////////////////
+// FILE:                        atlas.h                                  //
+///////////////////////////////////////////////////////////////////////////
+//                      BAHAMUT GRAPHICS LIBRARY                         //
+//                        Author: Corbin Stark                           //
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2019 Corbin Stark                                       //
+//                                                                       //
+// Permission is hereby granted, free of charge, to any person obtaining //
+// a copy of this software and associated documentation files (the       //
+// "Software"), to deal in the Software without restriction, including   //
+// without limitation the rights to use, copy, modify, merge, publish,   //
+// distribute, sublicense, and/or sell copies of the Software, and to    //
+// permit persons to whom the Software is furnished to do so, subject to //
+// the following conditions:                                             //
+//                                                                       //
+// The above copyright notice and this permission notice shall be        //
+// included in all copies or substantial portions of the Software.       //
+//                                                                       //
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       //
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    //
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.//
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  //
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  //
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     //
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include "defines.h"
+#include "texture.h"
+#include <vector>
+#include <SOIL.h>
+
+//a texture atlas packs many images into one GL texture so a batch drawing them
+//never runs out of texture slots. images are placed with a skyline packer: the
+//skyline is the top edge of everything packed so far as a list of horizontal
+//segments, and a new image goes wherever its bottom edge ends up lowest.
+//
+//a layered atlas is a GL_TEXTURE_2D_ARRAY with a skyline per layer, for batches
+//made by create_layered_batch. an image goes in the first layer it fits, and when
+//none has room the array grows a layer, since those batches draw from nothing else.
+
+#define ATLAS_PADDING 1 //empty texels between images so filtering never picks up a neighbor
+
+struct SkylineNode {
+	i32 x;
+	i32 y;
+	i32 width;
+};
+
+struct TextureAtlas {
+	Texture texture; //width and height are those of a layer
+	u16 param;
+	u32 images;
+	bool layered;
+	std::vector<std::vector<SkylineNode>> skylines; //one per layer
+	std::vector<GLuint> overflow; //textures for images that did not fit
+};
+
+INTERNAL inline
+TextureAtlas create_atlas(u32 width, u32 height, u16 param) {
+	TextureAtlas atlas;
+	//cleared so the padding between images is transparent
+	unsigned char* pixels = (unsigned char*)calloc(width * height, 4);
+	atlas.texture = load_texture(pixels, width, height, param);
+	free(pixels);
+	atlas.param = param;
+	atlas.images = 0;
+	atlas.layered = false;
+	atlas.skylines.push_back({ { 0, 0, (i32)width } });
+	return atlas;
+}
+
+INTERNAL inline
+TextureAtlas create_layered_atlas(u32 width, u32 height, u32 layers, u16 param) {
+	TextureAtlas atlas;
+	atlas.texture.width = width;
+	atlas.texture.height = height;
+	atlas.texture.flip_flag = 0;
+	set_whole_region(&atlas.texture);
+
+	glGenTextures(1, &atlas.texture.ID);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, atlas.texture.ID);
+	unsigned char* pixels = (unsigned char*)calloc(width * height * layers, 4);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	free(pixels);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, param);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, param);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	atlas.param = param;
+	atlas.images = 0;
+	atlas.layered = true;
+	for (u32 i = 0; i < layers; ++i)
+		atlas.skylines.push_back({ { 0, 0, (i32)width } });
+	return atlas;
+}
+
+INTERNAL inline
+void dispose_atlas(TextureAtlas* atlas) {
+	dispose_texture(atlas->texture);
+	for (u32 i = 0; i < atlas->overflow.size(); ++i)
+		glDeleteTextures(1, &atlas->overflow[i]);
+	atlas->overflow.clear();
+	atlas->skylines.clear();
+}
+
+//y an image placed at the start of the node would sit at, or -1 if it does not fit there
+INTERNAL inline
+i32 skyline_fit(TextureAtlas* atlas, std::vector<SkylineNode>* skyline, u32 index, i32 width, i32 height) {
+	if ((*skyline)[index].x + width > atlas->texture.width)
+		return -1;
+	i32 y = 0;
+	for (u32 i = index; width > 0; ++i) {
+		if ((*skyline)[i].y > y)
+			y = (*skyline)[i].y;
+		if (y + height > atlas->texture.height)
+			return -1;
+		width -= (*skyline)[i].width;
+	}
+	return y;
+}
+
+INTERNAL inline
+bool pack_skyline(TextureAtlas* atlas, std::vector<SkylineNode>* skyline, i32 width, i32 height, i32* x, i32* y) {
+	i32 bestIndex = -1;
+	i32 bestBottom = INT32_MAX;
+	i32 bestWidth = INT32_MAX;
+	for (u32 i = 0; i < skyline->size(); ++i) {
+		i32 top = skyline_fit(atlas, skyline, i, width, height);
+		if (top < 0)
+			continue;
+		//lowest bottom edge first, then the narrowest segment to waste less of the skyline
+		if (top + height < bestBottom || (top + height == bestBottom && (*skyline)[i].width < bestWidth)) {
+			bestIndex = i;
+			bestBottom = top + height;
+			bestWidth = (*skyline)[i].width;
+		}
+	}
+	if (bestIndex < 0)
+		return false;
+
+	*x = (*skyline)[bestIndex].x;
+	*y = bestBottom - height;
+	skyline->insert(skyline->begin() + bestIndex, { *x, bestBottom, width });
+
+	//the new segment covers the start of the ones after it
+	for (u32 i = bestIndex + 1; i < skyline->size();) {
+		SkylineNode* previous = &(*skyline)[i - 1];
+		SkylineNode* node = &(*skyline)[i];
+		i32 overlap = previous->x + previous->width - node->x;
+		if (overlap <= 0)
+			break;
+		if (overlap < node->width) {
+			node->x += overlap;
+			node->width -= overlap;
+			break;
+		}
+		skyline->erase(skyline->begin() + i);
+	}
+
+	for (u32 i = 0; i + 1 < skyline->size();) {
+		if ((*skyline)[i].y == (*skyline)[i + 1].y) {
+			(*skyline)[i].width += (*skyline)[i + 1].width;
+			skyline->erase(skyline->begin() + i + 1);
+		}
+		else {
+			++i;
+		}
+	}
+	return true;
+}
+
+//finds room in the first layer with any, the layer is counted from 0
+INTERNAL inline
+bool pack_atlas_region(TextureAtlas* atlas, i32 width, i32 height, i32* x, i32* y, u32* layer) {
+	for (u32 i = 0; i < atlas->skylines.size(); ++i) {
+		if (pack_skyline(atlas, &atlas->skylines[i], width, height, x, y)) {
+			*layer = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+//re-specifies the array one layer deeper under the same GL name, so the textures already
+//handed out keep working, then puts back what the old layers held
+INTERNAL inline
+void add_atlas_layer(TextureAtlas* atlas) {
+	u32 layers = atlas->skylines.size();
+	size_t size = (size_t)atlas->texture.width * atlas->texture.height * 4;
+	unsigned char* pixels = (unsigned char*)calloc(layers + 1, size);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, atlas->texture.ID);
+	glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, atlas->texture.width, atlas->texture.height, layers + 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	free(pixels);
+	atlas->skylines.push_back({ { 0, 0, (i32)atlas->texture.width } });
+}
+
+//==========================================================================================
+//Description: Copies an image into the atlas
+//
+//Parameters: 
+//		-The atlas to pack into
+//		-The RGBA pixels of the image
+//		-The size of the image
+//		-The width in pixels of the rows of pixels, for images cut out of a bigger one
+//
+//Comments: The texture returned shares the atlas's GL texture, so dispose the atlas and
+//			not the texture. An image that does not fit gets a texture of its own on a
+//			plain atlas, and a new layer on a layered one. An image bigger than a layer
+//			can never be drawn by a layered batch, so that is a fatal error.
+//==========================================================================================
+INTERNAL inline
+Texture add_to_atlas(TextureAtlas* atlas, unsigned char* pixels, i32 width, i32 height, i32 rowLength) {
+	i32 x, y;
+	u32 layer;
+	bool packed = pack_atlas_region(atlas, width + ATLAS_PADDING, height + ATLAS_PADDING, &x, &y, &layer);
+	if (!packed && atlas->layered) {
+		if (width + ATLAS_PADDING > atlas->texture.width || height + ATLAS_PADDING > atlas->texture.height)
+			BMT_LOG(FATAL_ERROR, "A %dx%d image can't fit in a %dx%d layer of the atlas, make the layers bigger", width, height, atlas->texture.width, atlas->texture.height);
+		BMT_LOG(WARNING, "Atlas is full, growing it to %u layers", (u32)atlas->skylines.size() + 1);
+		add_atlas_layer(atlas);
+		layer = atlas->skylines.size() - 1;
+		packed = pack_skyline(atlas, &atlas->skylines[layer], width + ATLAS_PADDING, height + ATLAS_PADDING, &x, &y);
+	}
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+	if (!packed) {
+		BMT_LOG(WARNING, "Atlas is full, giving a %dx%d image its own texture", width, height);
+		Texture texture = load_texture(pixels, width, height, atlas->param);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		atlas->overflow.push_back(texture.ID);
+		return texture;
+	}
+
+	if (atlas->layered) {
+		glBindTexture(GL_TEXTURE_2D_ARRAY, atlas->texture.ID);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+	else {
+		glBindTexture(GL_TEXTURE_2D, atlas->texture.ID);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	atlas->images++;
+
+	Texture texture;
+	texture.ID = atlas->texture.ID;
+	texture.flip_flag = 0;
+	texture.width = width;
+	texture.height = height;
+	texture.region[0] = (f32)x / atlas->texture.width;
+	texture.region[1] = (f32)y / atlas->texture.height;
+	texture.region[2] = (f32)(x + width) / atlas->texture.width;
+	texture.region[3] = (f32)(y + height) / atlas->texture.height;
+	texture.layer = atlas->layered ? layer + 1 : 0;
+	return texture;
+}
+
+INTERNAL inline
+Texture load_texture(TextureAtlas* atlas, const char* filepath) {
+	i32 width, height;
+	unsigned char* image = SOIL_load_image(filepath, &width, &height, 0, SOIL_LOAD_RGBA);
+	if (image == NULL) {
+		BMT_LOG(WARNING, "[%s] Texture could not be loaded! Returning blank texture.", filepath);
+		Texture texture = { 0 };
+		return texture;
+	}
+	Texture texture = add_to_atlas(atlas, image, width, height, width);
+	SOIL_free_image_data(image);
+	return texture;
+}
+
+#endif
@@ -35,6 +35,7 @@
 #include "render2D.h"
 #include "shader.h"
 #include "texture.h"
+#include "atlas.h"
 #include "window.h"
 #include "font.h"
 
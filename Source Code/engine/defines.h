@@ -39,8 +39,14 @@
 #include <stdlib.h>
 #include <cstdlib>
 #include <assert.h>
+//the game's simulation headers build with BMT_HEADLESS, which keeps these types and
+//helpers but drops the gl and glfw headers, for tools that never open a window
+#ifndef BMT_HEADLESS
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#else
+typedef char GLchar;
+#endif
 
 #define INTERNAL static
 #define LOCAL static
@@ -87,6 +87,7 @@ Texture create_texture_from_string(Font& font, const std::string str, i32 texPar
 	tex.width = w;
 	tex.height = h;
 	tex.flip_flag = 0;
+	set_whole_region(&tex);
 
 	glActiveTexture(GL_TEXTURE0);
 	glGenTextures(1, &tex.ID);
@@ -193,6 +194,7 @@ Font load_font(const GLchar* filepath, unsigned int size, i32 texParam) {
 		character->texture.width = font.face->glyph->bitmap.width;
 		character->texture.height = font.face->glyph->bitmap.rows;
 		character->texture.flip_flag = 0;
+		set_whole_region(&character->texture);
 
 		GLubyte* glyphPixels = font.face->glyph->bitmap.buffer;
 
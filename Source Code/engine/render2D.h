@@ -41,6 +41,17 @@ struct VertexData {
 	f32 texid;
 };
 
+//one sprite of an instanced batch, 32 bytes against the 144 of four VertexData.
+//the vertex shader expands it into the quad.
+struct SpriteInstance {
+	vec2 pos;   //top left corner before rotation
+	vec2 size;
+	u32 color;  //RGBA8, red in the low byte
+	u16 uv[4];  //top left and bottom right texture coordinates, 0-65535 for 0-1
+	u16 texid;
+	i16 angle;  //rotation about the center, -32767-32767 for -pi-pi
+};
+
 #ifndef BATCH_MAX_SPRITES
 #define BATCH_MAX_SPRITES	    20000
 #endif
@@ -51,61 +62,155 @@ struct VertexData {
 #define BATCH_INDICE_SIZE	    BATCH_MAX_SPRITES * 6
 #define BATCH_MAX_TEXTURES		16
 
+//the vertex buffer is a ring of regions, one filled per begin2D/end2D, so the cpu
+//writes one region while the gpu is still reading the ones before it
+#ifndef BATCH_REGIONS
+#define BATCH_REGIONS			3
+#endif
+
+//a deferred batch keeps the command index in the low 16 bits of each sort key
+#if BATCH_MAX_SPRITES > 65536
+#error "BATCH_MAX_SPRITES must fit in 16 bits"
+#endif
+
+//a sprite recorded by a deferred batch, waiting for end2D to sort it
+struct SpriteCommand {
+	SpriteInstance sprite;
+	GLuint texture; //0 for untextured
+};
+
 struct RenderBatch {
 	u32 vao;
 	u32 vbo;
 	u32 ebo;
-	u16 indexcount;
+	u32 indexcount;
 	u16 texcount;
 	GLuint  textures[BATCH_MAX_TEXTURES];
-	GLchar* locations[BATCH_MAX_TEXTURES];
 	VertexData* buffer;
 	Shader shader;
+	ShaderUniform* samplers[BATCH_MAX_TEXTURES]; //the shader's sampler for each slot, NULL if it has none
+	bool blending; //what begin2D was asked for, kept for the flushes in between
+	bool depthtest;
+	bool instanced;
+	bool layered; //samples one GL_TEXTURE_2D_ARRAY, see create_layered_batch
+	u32 instancecount;
+	SpriteInstance* instances;
+
+	u32 regionsize; //bytes
+	u32 region; //the one being filled
+	GLsync fences[BATCH_REGIONS]; //signaled once the gpu is done reading each region
+	u8* mapped; //the whole ring, persistently mapped, or NULL without buffer storage
+	u8* staging; //where the sprites go before glBufferSubData without buffer storage
+	u32 stalls; //times begin2D had to wait for the gpu to free a region
+
+	//deferred batches record every sprite and draw them sorted at end2D, see set_batch_deferred
+	bool deferred;
+	u8 layer;
+	u16 depth;
+	u32 commandcount;
+	SpriteCommand* commands;
+	u64* keys; //layer, texture, depth, then the command index
+	u64* sortscratch;
 };
 
 void end2D(RenderBatch* batch);
 
+//the sampler for each texture slot, as the 16-sampler shader names them
+LOCAL const GLchar* BATCH_SAMPLER_NAMES[BATCH_MAX_TEXTURES] = {
+	"tex1", "tex2", "tex3", "tex4", "tex5", "tex6", "tex7", "tex8",
+	"tex9", "tex10", "tex11", "tex12", "tex13", "tex14", "tex15", "tex16"
+};
+
+//of the current context
+INTERNAL inline
+bool has_gl_version(i32 major, i32 minor) {
+	GLint contextMajor = 0, contextMinor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+	glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+	return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
+
+//persistent mapping needs GL 4.4 or ARB_buffer_storage
+INTERNAL inline
+bool has_buffer_storage() {
+#ifdef BATCH_NO_BUFFER_STORAGE
+	return false;
+#else
+	if (has_gl_version(4, 4))
+		return true;
+
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; ++i) {
+		if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_buffer_storage") == 0)
+			return true;
+	}
+	return false;
+#endif
+}
+
+//makes the ring for the vbo bound to GL_ARRAY_BUFFER
+INTERNAL inline
+void create_batch_ring(RenderBatch* batch, u32 regionSize) {
+	batch->regionsize = regionSize;
+	batch->region = 0;
+	for (u32 i = 0; i < BATCH_REGIONS; ++i)
+		batch->fences[i] = 0;
+
+	if (has_buffer_storage()) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, regionSize * BATCH_REGIONS, NULL, flags);
+		batch->mapped = (u8*)glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * BATCH_REGIONS, flags);
+		batch->staging = NULL;
+	}
+	else {
+		glBufferData(GL_ARRAY_BUFFER, regionSize * BATCH_REGIONS, NULL, GL_STREAM_DRAW);
+		batch->mapped = NULL;
+		batch->staging = (u8*)malloc(regionSize);
+	}
+}
+
+//the last argument to glVertexAttribPointer is the offset from the start of the buffer to the
+//data you want to look at - so each new attrib adds up all the ones before it, on top of where
+//the region being drawn starts.
+INTERNAL inline
+void point_batch_attribs(RenderBatch* batch, size_t base) {
+	if (batch->instanced) {
+		GLsizei stride = sizeof(SpriteInstance);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)(base + offsetof(SpriteInstance, pos)));
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (const GLvoid*)(base + offsetof(SpriteInstance, color)));
+		glVertexAttribPointer(2, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, (const GLvoid*)(base + offsetof(SpriteInstance, uv)));
+		//a layered batch reads texid as the integer array layer rather than a float slot
+		if (batch->layered)
+			glVertexAttribIPointer(3, 1, GL_UNSIGNED_SHORT, stride, (const GLvoid*)(base + offsetof(SpriteInstance, texid)));
+		else
+			glVertexAttribPointer(3, 1, GL_UNSIGNED_SHORT, GL_FALSE, stride, (const GLvoid*)(base + offsetof(SpriteInstance, texid)));
+		glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)(base + offsetof(SpriteInstance, size)));
+		glVertexAttribPointer(5, 1, GL_SHORT, GL_FALSE, stride, (const GLvoid*)(base + offsetof(SpriteInstance, angle)));
+		return;
+	}
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, BATCH_VERTEX_SIZE, (const GLvoid*)(base));                         //vertices
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, BATCH_VERTEX_SIZE, (const GLvoid*)(base + 2 * sizeof(GLfloat))); //color
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, BATCH_VERTEX_SIZE, (const GLvoid*)(base + 6 * sizeof(GLfloat))); //tex coords
+	glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, BATCH_VERTEX_SIZE, (const GLvoid*)(base + 8 * sizeof(GLfloat))); //texture id
+}
+
 INTERNAL inline
 RenderBatch create_batch() {
 	RenderBatch batch = { 0 };
 
-	for (u32 i = 0; i < BATCH_MAX_TEXTURES; ++i)
-		batch.locations[i] = (GLchar*)malloc(6 * sizeof(GLchar));
-
-	strcpy(batch.locations[0], "tex1");
-	strcpy(batch.locations[1], "tex2");
-	strcpy(batch.locations[2], "tex3");
-	strcpy(batch.locations[3], "tex4");
-	strcpy(batch.locations[4], "tex5");
-	strcpy(batch.locations[5], "tex6");
-	strcpy(batch.locations[6], "tex7");
-	strcpy(batch.locations[7], "tex8");
-	strcpy(batch.locations[8], "tex9");
-	strcpy(batch.locations[9], "tex10");
-	strcpy(batch.locations[10], "tex11");
-	strcpy(batch.locations[11], "tex12");
-	strcpy(batch.locations[12], "tex13");
-	strcpy(batch.locations[13], "tex14");
-	strcpy(batch.locations[14], "tex15");
-	strcpy(batch.locations[15], "tex16");
-
 	glGenVertexArrays(1, &batch.vao);
 	glBindVertexArray(batch.vao);
 
 	glGenBuffers(1, &batch.vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
-	glBufferData(GL_ARRAY_BUFFER, BATCH_BUFFER_SIZE, NULL, GL_DYNAMIC_DRAW);
+	create_batch_ring(&batch, BATCH_BUFFER_SIZE);
+	point_batch_attribs(&batch, 0);
 
-	//the last argument to glVertexAttribPointer is the offset from the start of the vertex to the
-	//data you want to look at - so each new attrib adds up all the ones before it.
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, BATCH_VERTEX_SIZE, (const GLvoid*)0);                     //vertices
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, BATCH_VERTEX_SIZE, (const GLvoid*)(2 * sizeof(GLfloat))); //color
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, BATCH_VERTEX_SIZE, (const GLvoid*)(6 * sizeof(GLfloat))); //tex coords
-	glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, BATCH_VERTEX_SIZE, (const GLvoid*)(8 * sizeof(GLfloat))); //texture id
+	//80000 vertices is past what 16 bit indices reach, and too big for the stack
+	GLuint* indices = (GLuint*)malloc(BATCH_INDICE_SIZE * sizeof(GLuint));
 
-	GLushort indices[BATCH_INDICE_SIZE];
-
-	int offset = 0;
+	u32 offset = 0;
 	for (u32 i = 0; i < BATCH_INDICE_SIZE; i += 6) {
 		indices[i] = offset + 0;
 		indices[i + 1] = offset + 1;
@@ -119,7 +224,8 @@ RenderBatch create_batch() {
 
 	glGenBuffers(1, &batch.ebo);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, BATCH_INDICE_SIZE * sizeof(GLushort), indices, GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, BATCH_INDICE_SIZE * sizeof(GLuint), indices, GL_STATIC_DRAW);
+	free(indices);
 
 	//the vao must be unbound before the buffers
 	glBindVertexArray(0);
@@ -129,9 +235,67 @@ RenderBatch create_batch() {
 	return batch;
 }
 
+//draws the same draw_* calls from one SpriteInstance per sprite instead of four vertices,
+//use it with load_instanced_shader_2D
+INTERNAL inline
+RenderBatch create_instanced_batch() {
+	RenderBatch batch = { 0 };
+	batch.instanced = true;
+
+	glGenVertexArrays(1, &batch.vao);
+	glBindVertexArray(batch.vao);
+
+	glGenBuffers(1, &batch.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+	create_batch_ring(&batch, BATCH_MAX_SPRITES * sizeof(SpriteInstance));
+	point_batch_attribs(&batch, 0);
+
+	//every attribute steps once per sprite rather than once per vertex
+	for (u32 i = 0; i < 6; ++i) {
+		glVertexAttribDivisor(i, 1);
+		glEnableVertexAttribArray(i);
+	}
+
+	//a single quad, the corners are told apart by gl_VertexID
+	GLushort indices[6] = { 0, 1, 2, 2, 3, 0 };
+	glGenBuffers(1, &batch.ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	return batch;
+}
+
+//an instanced batch whose sprites all come from one layered atlas, so end2D binds a single
+//texture and the shader picks the layer without branching. use it with load_layered_shader_2D.
+//textures must come from create_layered_atlas, a sprite without one is drawn as a flat color.
+INTERNAL inline
+RenderBatch create_layered_batch() {
+	RenderBatch batch = create_instanced_batch();
+	batch.layered = true;
+
+	glBindVertexArray(batch.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+	point_batch_attribs(&batch, 0);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return batch;
+}
+
 INTERNAL inline
 void begin2D(RenderBatch* batch, Shader shader, bool blending = true, bool depthTest = false) {
+	//the sampler handles are looked up when the shader changes rather than on every flush
+	if (batch->shader.ID != shader.ID || batch->shader.uniforms != shader.uniforms) {
+		for (u32 i = 0; i < BATCH_MAX_TEXTURES; ++i)
+			batch->samplers[i] = get_uniform(shader, BATCH_SAMPLER_NAMES[i]);
+	}
 	batch->shader = shader;
+	batch->blending = blending;
+	batch->depthtest = depthTest;
 	start_shader(shader);
 
 	if (blending)
@@ -143,14 +307,61 @@ void begin2D(RenderBatch* batch, Shader shader, bool blending = true, bool depth
 	else
 		glDisable(GL_DEPTH_TEST);
 
-	glBindBuffer(GL_ARRAY_BUFFER, batch->vbo);
-	batch->buffer = (VertexData*)glMapBufferRange(GL_ARRAY_BUFFER, 0, BATCH_BUFFER_SIZE,
-		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
-	);
+	u8* start = batch->staging;
+	if (batch->mapped) {
+		//only waits if the gpu is BATCH_REGIONS flushes behind
+		GLsync fence = batch->fences[batch->region];
+		if (fence) {
+			if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+				batch->stalls++;
+				while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+			}
+			glDeleteSync(fence);
+			batch->fences[batch->region] = 0;
+		}
+		start = batch->mapped + batch->region * batch->regionsize;
+	}
+	if (batch->instanced)
+		batch->instances = (SpriteInstance*)start;
+	else
+		batch->buffer = (VertexData*)start;
+}
+
+//draws what is in the batch so far and carries on with an empty one
+INTERNAL inline
+void flush_batch(RenderBatch* batch) {
+	end2D(batch);
+	begin2D(batch, batch->shader, batch->blending, batch->depthtest);
 }
 
+//call before writing each sprite, a full batch gets flushed
+INTERNAL inline
+void reserve_sprite(RenderBatch* batch) {
+	u32 sprites = batch->instanced ? batch->instancecount : batch->indexcount / 6;
+	if (batch->deferred)
+		sprites = batch->commandcount;
+	if (sprites >= BATCH_MAX_SPRITES)
+		flush_batch(batch);
+}
+
+//reserves room for the sprite too, so the slot returned stays valid until it is written
 INTERNAL inline
 i32 submit_tex(RenderBatch* batch, Texture tex) {
+	reserve_sprite(batch);
+	//the layer is the slot, a different array means a flush
+	if (batch->layered) {
+		assert(tex.layer != 0);
+		if (batch->deferred)
+			return tex.layer;
+		if (batch->texcount > 0 && batch->textures[0] != tex.ID)
+			flush_batch(batch);
+		batch->textures[0] = tex.ID;
+		batch->texcount = 1;
+		return tex.layer;
+	}
+	//deferred batches hand out slots when the sorted sprites are emitted
+	if (batch->deferred)
+		return 0;
 	int texSlot = 0;
 	bool found = false;
 	for (u32 i = 0; i < batch->texcount; ++i) {
@@ -161,16 +372,152 @@ i32 submit_tex(RenderBatch* batch, Texture tex) {
 		}
 	}
 	if (!found) {
-		if (batch->texcount >= BATCH_MAX_TEXTURES) {
-			end2D(batch);
-			begin2D(batch, batch->shader);
-		}
+		if (batch->texcount >= BATCH_MAX_TEXTURES)
+			flush_batch(batch);
 		batch->textures[batch->texcount++] = tex.ID;
 		texSlot = batch->texcount;
 	}
 	return texSlot;
 }
 
+//moves uvs over the whole image into the part of the GL texture the image lives in
+INTERNAL inline
+void map_to_region(Texture tex, f32* uvs, f32* out) {
+	for (u32 i = 0; i < 8; i += 2) {
+		out[i] = tex.region[0] + uvs[i] * (tex.region[2] - tex.region[0]);
+		out[i + 1] = tex.region[1] + uvs[i + 1] * (tex.region[3] - tex.region[1]);
+	}
+}
+
+INTERNAL inline
+u32 pack_unorm8(f32 value) {
+	if (value <= 0) return 0;
+	if (value >= 1) return 255;
+	return (u32)(value * 255.0f + 0.5f);
+}
+
+INTERNAL inline
+u16 pack_unorm16(f32 value) {
+	if (value <= 0) return 0;
+	if (value >= 1) return 65535;
+	return (u16)(value * 65535.0f + 0.5f);
+}
+
+//colors are 0-1, uvs are the top left and bottom right corners and the angle is in radians
+INTERNAL inline
+void push_instance(RenderBatch* batch, f32 x, f32 y, f32 width, f32 height, f32 u0, f32 v0, f32 u1, f32 v1,
+	f32 r, f32 g, f32 b, f32 a, i32 texSlot, GLuint texture, f32 angle = 0) {
+	angle = fmodf(angle, 2 * PI);
+	if (angle > PI) angle -= 2 * PI;
+	if (angle < -PI) angle += 2 * PI;
+
+	SpriteInstance* sprite = batch->instances;
+	if (batch->deferred) {
+		u32 index = batch->commandcount++;
+		batch->commands[index].texture = texture;
+		batch->keys[index] = (u64)batch->layer << 56 | (u64)(texture & 0xFFFFFF) << 32 | (u64)batch->depth << 16 | index;
+		sprite = &batch->commands[index].sprite;
+	}
+	else {
+		batch->instances++;
+		batch->instancecount++;
+	}
+	sprite->pos = { x, y };
+	sprite->size = { width, height };
+	sprite->color = pack_unorm8(a) << 24 | pack_unorm8(b) << 16 | pack_unorm8(g) << 8 | pack_unorm8(r);
+	sprite->uv[0] = pack_unorm16(u0);
+	sprite->uv[1] = pack_unorm16(v0);
+	sprite->uv[2] = pack_unorm16(u1);
+	sprite->uv[3] = pack_unorm16(v1);
+	sprite->texid = texSlot;
+	sprite->angle = (i16)(angle / PI * 32767.0f);
+}
+
+//==========================================================================================
+//Description: Switches an instanced batch between drawing in call order and deferred drawing
+//
+//Parameters: 
+//		-A batch made by create_instanced_batch
+//		-Whether to defer
+//
+//Comments: A deferred batch records sprites and sorts them at end2D by layer, then texture,
+//			then depth, keeping call order among equal keys. Every texture in a layer is
+//			drawn together, so sprites in one layer that overlap should share a texture or
+//			go in different layers. Call outside begin2D/end2D.
+//==========================================================================================
+INTERNAL inline
+void set_batch_deferred(RenderBatch* batch, bool deferred) {
+	assert(batch->instanced);
+	if (deferred && batch->commands == NULL) {
+		batch->commands = (SpriteCommand*)malloc(BATCH_MAX_SPRITES * sizeof(SpriteCommand));
+		batch->keys = (u64*)malloc(BATCH_MAX_SPRITES * sizeof(u64));
+		batch->sortscratch = (u64*)malloc(BATCH_MAX_SPRITES * sizeof(u64));
+	}
+	batch->deferred = deferred;
+	batch->commandcount = 0;
+}
+
+//layer 0 draws first. depth orders sprites of the same layer and texture, 0 first
+INTERNAL inline
+void set_draw_layer(RenderBatch* batch, u8 layer, u16 depth = 0) {
+	batch->layer = layer;
+	batch->depth = depth;
+}
+
+//lsd radix sort, a byte at a time over everything above the command index.
+//returns whichever of the two arrays ends up holding the sorted keys.
+INTERNAL inline
+u64* radix_sort_keys(u64* keys, u64* scratch, u32 count) {
+	for (u32 shift = 16; shift < 64; shift += 8) {
+		u32 offsets[256] = { 0 };
+		for (u32 i = 0; i < count; ++i)
+			offsets[(keys[i] >> shift) & 255]++;
+		//most passes see one value, layer and depth are often unused and textures are few
+		if (offsets[(keys[0] >> shift) & 255] == count)
+			continue;
+
+		u32 offset = 0;
+		for (u32 i = 0; i < 256; ++i) {
+			u32 bucket = offsets[i];
+			offsets[i] = offset;
+			offset += bucket;
+		}
+		for (u32 i = 0; i < count; ++i)
+			scratch[offsets[(keys[i] >> shift) & 255]++] = keys[i];
+
+		u64* sorted = scratch;
+		scratch = keys;
+		keys = sorted;
+	}
+	return keys;
+}
+
+//writes the recorded sprites into the instance buffer in key order
+INTERNAL inline
+void emit_sorted_sprites(RenderBatch* batch) {
+	u32 count = batch->commandcount;
+	u64* keys = radix_sort_keys(batch->keys, batch->sortscratch, count);
+
+	//submit_tex hands out slots again, and a flush for a 17th texture draws rather than sorts
+	batch->deferred = false;
+	batch->commandcount = 0;
+	for (u32 i = 0; i < count; ++i) {
+		SpriteCommand* command = &batch->commands[keys[i] & 0xFFFF];
+		i32 texSlot = 0;
+		if (command->texture != 0) {
+			Texture tex = { 0 };
+			tex.ID = command->texture;
+			tex.layer = command->sprite.texid; //what submit_tex gave a layered batch
+			texSlot = submit_tex(batch, tex);
+		}
+		*batch->instances = command->sprite;
+		batch->instances->texid = texSlot;
+		batch->instances++;
+		batch->instancecount++;
+	}
+	batch->deferred = true;
+}
+
 INTERNAL inline
 void draw_texture(RenderBatch* batch, Texture tex, i32 xPos, i32 yPos, f32 r, f32 g, f32 b, f32 a) {
 	if (tex.ID == 0)
@@ -193,6 +540,14 @@ void draw_texture(RenderBatch* batch, Texture tex, i32 xPos, i32 yPos, f32 r, f3
 		uvs = FLIP_HOR_UVS;
 	if (tex.flip_flag & FLIP_VERTICAL)
 		uvs = FLIP_VER_UVS;
+	f32 regionUvs[8];
+	map_to_region(tex, uvs, regionUvs);
+	uvs = regionUvs;
+
+	if (batch->instanced) {
+		push_instance(batch, x, y, tex.width, tex.height, uvs[0], uvs[1], uvs[4], uvs[5], r, g, b, a, texSlot, tex.ID);
+		return;
+	}
 
 	batch->buffer->pos = {x, y};
 	batch->buffer->color = {r, g, b, a};
@@ -250,6 +605,9 @@ void draw_texture_rotated(RenderBatch* batch, Texture tex, i32 x, i32 y, vec2 or
 		uvs = FLIP_HOR_UVS;
 	if (tex.flip_flag & FLIP_VERTICAL)
 		uvs = FLIP_VER_UVS;
+	f32 regionUvs[8];
+	map_to_region(tex, uvs, regionUvs);
+	uvs = regionUvs;
 
 	f32 cosine = 1;
 	f32 sine = 0;
@@ -259,6 +617,16 @@ void draw_texture_rotated(RenderBatch* batch, Texture tex, i32 x, i32 y, vec2 or
 		sine = sin(rotation);
 	}
 
+	if (batch->instanced) {
+		//instances turn about their center, so move the center to where turning about origin puts it
+		f32 centerX = x + tex.width / 2.0f - origin.x;
+		f32 centerY = y + tex.height / 2.0f - origin.y;
+		f32 left = cosine * centerX - sine * centerY + origin.x - tex.width / 2.0f;
+		f32 top = sine * centerX + cosine * centerY + origin.y - tex.height / 2.0f;
+		push_instance(batch, left, top, tex.width, tex.height, uvs[0], uvs[1], uvs[4], uvs[5], r, g, b, a, texSlot, tex.ID, rotation);
+		return;
+	}
+
 	batch->buffer->pos = {
 		cosine * (x - origin.x) - sine * (y - origin.y) + origin.x, 
 		sine * (x - origin.x) + cosine * (y - origin.y) + origin.y
@@ -360,8 +728,14 @@ void draw_texture_EX(RenderBatch* batch, Texture tex, Rect source, Rect dest, f3
 		uvs[7] = (source.y + source.height) / tex.height;
 	}
 
+	map_to_region(tex, uvs, uvs);
 	i32 texSlot = submit_tex(batch, tex);
 
+	if (batch->instanced) {
+		push_instance(batch, dest.x, dest.y, dest.width, dest.height, uvs[0], uvs[1], uvs[4], uvs[5], r, g, b, a, texSlot, tex.ID);
+		return;
+	}
+
 	batch->buffer->pos = {dest.x, dest.y};
 	batch->buffer->color = { r, g, b, a };
 	batch->buffer->uv = { uvs[0], uvs[1] };
@@ -421,8 +795,14 @@ void draw_text(RenderBatch* batch, Font* font, const char* str, i32 xPos, i32 yP
 
 		Texture tex = font->characters[str[i]]->texture;
 		int texSlot = submit_tex(batch, tex);
-		GLfloat* uvs;
-		uvs = DEFAULT_UVS;
+		GLfloat uvs[8];
+		map_to_region(tex, DEFAULT_UVS, uvs);
+
+		if (batch->instanced) {
+			push_instance(batch, x, y, tex.width, tex.height, uvs[0], uvs[1], uvs[4], uvs[5], r, g, b, 1, texSlot, tex.ID);
+			xPos += (font->characters[str[i]]->advance >> 6);
+			continue;
+		}
 
 		batch->buffer->pos.x = x;
 		batch->buffer->pos.y = y;
@@ -493,6 +873,12 @@ void draw_rectangle(RenderBatch* batch, i32 xPos, i32 yPos, i32 width, i32 heigh
 	b /= 255;
 	a /= 255;
 
+	reserve_sprite(batch);
+	if (batch->instanced) {
+		push_instance(batch, x, y, width, height, 0, 0, 0, 0, r, g, b, a, 0, 0);
+		return;
+	}
+
 	batch->buffer->pos = { x, y };
 	batch->buffer->color = { r, g, b, a };
 	batch->buffer->uv = { 0, 0 };
@@ -529,30 +915,75 @@ void draw_rectangle(RenderBatch* batch, i32 x, i32 y, i32 width, i32 height, vec
 
 //void draw_text(Font& font, std::string str, i32 xPos, i32 yPos, f32 r = 255.0f, f32 g = 255.0f, f32 b = 255.0f);
 
+//fences the region just drawn from and moves on to the next
+INTERNAL inline
+void next_batch_region(RenderBatch* batch) {
+	if (batch->mapped)
+		batch->fences[batch->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	batch->region = (batch->region + 1) % BATCH_REGIONS;
+}
+
 INTERNAL inline
 void end2D(RenderBatch* batch) {
-	glUnmapBuffer(GL_ARRAY_BUFFER);
+	if (batch->deferred && batch->commandcount > 0)
+		emit_sorted_sprites(batch);
+
+	size_t base = batch->region * batch->regionsize;
+	glBindVertexArray(batch->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, batch->vbo);
+	if (!batch->mapped) {
+		u8* end = batch->instanced ? (u8*)batch->instances : (u8*)batch->buffer;
+		glBufferSubData(GL_ARRAY_BUFFER, base, end - batch->staging, batch->staging);
+	}
+	point_batch_attribs(batch, base);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	for (u16 i = 0; i < batch->texcount; ++i) {
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, batch->textures[i]);
-		upload_int(batch->shader, batch->locations[i], i);
+	if (batch->layered) {
+		//"sprites" is left on unit 0, its default
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, batch->texcount > 0 ? batch->textures[0] : 0);
+	}
+	else {
+		for (u16 i = 0; i < batch->texcount; ++i) {
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(GL_TEXTURE_2D, batch->textures[i]);
+			//a slot keeps its unit, so after the first flush the upload is skipped
+			upload_int(batch->samplers[i], i);
+		}
+	}
+
+	if (batch->instanced) {
+		glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0, batch->instancecount);
+		glBindVertexArray(0);
+		next_batch_region(batch);
+
+		if (batch->layered)
+			glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		else {
+			for (u16 i = 0; i < batch->texcount; ++i)
+				unbind_texture(batch->textures[i]);
+		}
+
+		batch->instancecount = 0;
+		batch->texcount = 0;
+
+		stop_shader();
+		return;
 	}
 
-	glBindVertexArray(batch->vao);
 	glEnableVertexAttribArray(0); //position
 	glEnableVertexAttribArray(1); //color
 	glEnableVertexAttribArray(2); //texture coordinates
 	glEnableVertexAttribArray(3); //texture ID
 
-	glDrawElements(GL_TRIANGLES, batch->indexcount, GL_UNSIGNED_SHORT, 0);
+	glDrawElements(GL_TRIANGLES, batch->indexcount, GL_UNSIGNED_INT, 0);
 
 	glDisableVertexAttribArray(0); //position
 	glDisableVertexAttribArray(1); //color
 	glDisableVertexAttribArray(2); //texture coordinates
 	glDisableVertexAttribArray(3); //textureID
 	glBindVertexArray(0);
+	next_batch_region(batch);
 
 	for (u16 i = 0; i < batch->texcount; ++i)
 		unbind_texture(batch->textures[i]);
@@ -563,9 +994,8 @@ void end2D(RenderBatch* batch) {
 	stop_shader();
 }
 
-INTERNAL inline
-Shader load_default_shader_2D() {
-	LOCAL const GLchar* ORTHO_SHADER_FRAG_SHADER = R"FOO(
+//shared by the vertex and instanced batches
+LOCAL const GLchar* ORTHO_SHADER_FRAG_SHADER = R"FOO(
 #version 130
 out vec4 outColor;
 
@@ -614,6 +1044,8 @@ void main() {
 
 )FOO";
 
+INTERNAL inline
+Shader load_default_shader_2D() {
 	LOCAL const GLchar* ORTHO_SHADER_VERT_SHADER = R"FOO(
 #version 130
 in vec2 position;
@@ -640,8 +1072,115 @@ void main() {
 	return load_shader_2D_from_strings(ORTHO_SHADER_VERT_SHADER, ORTHO_SHADER_FRAG_SHADER);
 }
 
+INTERNAL inline
+Shader load_instanced_shader_2D() {
+	LOCAL const GLchar* INSTANCED_SHADER_VERT_SHADER = R"FOO(
+#version 130
+in vec2 position;
+in vec2 size;
+in vec4 color;
+in vec4 uv;
+in float texid;
+in float angle;
+
+uniform mat4 projection = mat4(1.0);
+uniform mat4 view = mat4(1.0);
+
+out vec4 pass_color;
+out vec2 pass_uv;
+out float pass_texid;
+
+void main() {
+	//same corner order as the vertex batch: top left, bottom left, bottom right, top right
+	vec2 corner = vec2(gl_VertexID >= 2 ? 1.0 : 0.0, (gl_VertexID == 1 || gl_VertexID == 2) ? 1.0 : 0.0);
+	vec2 offset = corner * size;
+	if(angle != 0.0) {
+		float theta = angle * (3.14159265 / 32767.0);
+		vec2 center = size * 0.5;
+		offset = mat2(cos(theta), sin(theta), -sin(theta), cos(theta)) * (offset - center) + center;
+	}
+
+	pass_color = color;
+	pass_uv = mix(uv.xy, uv.zw, corner);
+	pass_texid = texid;
+
+	gl_Position = projection * view * vec4(position + offset, 1.0, 1.0);
+}
+
+)FOO";
+	return load_shader_2D_from_strings(INSTANCED_SHADER_VERT_SHADER, ORTHO_SHADER_FRAG_SHADER);
+}
+
+//for create_layered_batch. layer 0 is an untextured sprite, any other is layer - 1 of the array
+INTERNAL inline
+Shader load_layered_shader_2D() {
+	LOCAL const GLchar* LAYERED_SHADER_VERT_SHADER = R"FOO(
+#version 130
+in vec2 position;
+in vec2 size;
+in vec4 color;
+in vec4 uv;
+in uint texid;
+in float angle;
+
+uniform mat4 projection = mat4(1.0);
+uniform mat4 view = mat4(1.0);
+
+out vec4 pass_color;
+out vec2 pass_uv;
+flat out uint pass_layer;
+
+void main() {
+	vec2 corner = vec2(gl_VertexID >= 2 ? 1.0 : 0.0, (gl_VertexID == 1 || gl_VertexID == 2) ? 1.0 : 0.0);
+	vec2 offset = corner * size;
+	if(angle != 0.0) {
+		float theta = angle * (3.14159265 / 32767.0);
+		vec2 center = size * 0.5;
+		offset = mat2(cos(theta), sin(theta), -sin(theta), cos(theta)) * (offset - center) + center;
+	}
+
+	pass_color = color;
+	pass_uv = mix(uv.xy, uv.zw, corner);
+	pass_layer = texid;
+
+	gl_Position = projection * view * vec4(position + offset, 1.0, 1.0);
+}
+
+)FOO";
+	LOCAL const GLchar* LAYERED_SHADER_FRAG_SHADER = R"FOO(
+#version 130
+out vec4 outColor;
+
+in vec4 pass_color;
+in vec2 pass_uv;
+flat in uint pass_layer;
+
+uniform sampler2DArray sprites;
+void main() {
+	//a select rather than a branch, layer -1 is clamped to 0 for the untextured sprites
+	vec4 texColor = texture(sprites, vec3(pass_uv, float(pass_layer) - 1.0));
+	outColor = pass_color * (pass_layer == 0u ? vec4(1.0) : texColor);
+}
+
+)FOO";
+	return load_shader_2D_from_strings(LAYERED_SHADER_VERT_SHADER, LAYERED_SHADER_FRAG_SHADER);
+}
+
 INTERNAL inline
 void dispose_batch(RenderBatch* batch) {
+	for (u32 i = 0; i < BATCH_REGIONS; ++i) {
+		if (batch->fences[i])
+			glDeleteSync(batch->fences[i]);
+	}
+	if (batch->mapped) {
+		glBindBuffer(GL_ARRAY_BUFFER, batch->vbo);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	free(batch->staging);
+	free(batch->commands);
+	free(batch->keys);
+	free(batch->sortscratch);
 	glDeleteVertexArrays(1, &batch->vao);
 	glDeleteBuffers(1, &batch->vbo);
 	glDeleteBuffers(1, &batch->ebo);
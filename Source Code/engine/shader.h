@@ -33,14 +33,94 @@
 #include "maths.h"
 #include <vector>
 
+#define UNIFORM_NAME_LENGTH 64
+
+//an active uniform of a linked program, found once at link time. the last value
+//uploaded through it is kept, so uploading the same value again makes no gl call.
+//that only holds while its own program is the one in use, see uniform_changed.
+struct ShaderUniform {
+	u32 hash; //of the name, 0 marks an empty slot
+	GLuint program; //the program the location belongs to
+	GLint location;
+	GLenum type;
+	GLint size; //elements, for arrays
+	bool cached;
+	u8 value[sizeof(mat4)]; //the last value uploaded, if cached
+	GLchar name[UNIFORM_NAME_LENGTH];
+};
+
 struct Shader {
 	GLuint ID;
 	GLuint vertexshaderID;
 	GLuint fragshaderID;
+	ShaderUniform* uniforms; //open addressed by name hash, shared by every copy of the shader
+	u32 uniformslots; //a power of two, at least twice the uniforms
 };
 
+//fnv-1a, never 0
+INTERNAL inline
+u32 hash_uniform_name(const GLchar* name) {
+	u32 hash = 2166136261u;
+	for (; *name; ++name)
+		hash = (hash ^ (u8)*name) * 16777619u;
+	return hash ? hash : 1;
+}
+
+//fills the shader's uniform table, call once the program is linked
+INTERNAL inline
+void reflect_uniforms(Shader* shader) {
+	GLint count = 0;
+	glGetProgramiv(shader->ID, GL_ACTIVE_UNIFORMS, &count);
+	u32 slots = 8;
+	while (slots < (u32)count * 2)
+		slots *= 2;
+	shader->uniformslots = slots;
+	shader->uniforms = (ShaderUniform*)calloc(slots, sizeof(ShaderUniform));
+
+	for (GLint i = 0; i < count; ++i) {
+		ShaderUniform uniform = { 0 };
+		GLsizei length = 0;
+		glGetActiveUniform(shader->ID, i, UNIFORM_NAME_LENGTH, &length, &uniform.size, &uniform.type, uniform.name);
+		//arrays are listed as name[0], which GL also finds by name alone
+		if (length > 3 && strcmp(uniform.name + length - 3, "[0]") == 0)
+			uniform.name[length - 3] = 0;
+		uniform.program = shader->ID;
+		uniform.location = glGetUniformLocation(shader->ID, uniform.name);
+		if (uniform.location < 0)
+			continue; //in a uniform block
+		uniform.hash = hash_uniform_name(uniform.name);
+
+		u32 slot = uniform.hash & (slots - 1);
+		while (shader->uniforms[slot].hash != 0)
+			slot = (slot + 1) & (slots - 1);
+		shader->uniforms[slot] = uniform;
+	}
+}
+
+//a handle for the upload_* overloads that skip the lookup, or NULL if the shader has
+//no such active uniform. stays valid until the shader is disposed.
+INTERNAL inline
+ShaderUniform* get_uniform(Shader shader, const GLchar* name) {
+	if (shader.uniforms == NULL)
+		return NULL;
+	u32 hash = hash_uniform_name(name);
+	u32 mask = shader.uniformslots - 1;
+	//the table is never more than half full, so there is always an empty slot to stop at
+	for (u32 slot = hash & mask;; slot = (slot + 1) & mask) {
+		ShaderUniform* uniform = &shader.uniforms[slot];
+		if (uniform->hash == 0)
+			return NULL;
+		if (uniform->hash == hash && strcmp(uniform->name, name) == 0)
+			return uniform;
+	}
+}
+
+//names the table does not hold, like one element of an array, are asked of GL
 INTERNAL inline
 GLint get_uniform_location(Shader shader, const GLchar* name) {
+	ShaderUniform* uniform = get_uniform(shader, name);
+	if (uniform)
+		return uniform->location;
 	return glGetUniformLocation(shader.ID, name);
 }
 
@@ -114,8 +194,11 @@ Shader load_shader_2D(const GLchar* vertexfile, const GLchar* fragmentfile) {
 	glBindAttribLocation(shader.ID, 1, "color");
 	glBindAttribLocation(shader.ID, 2, "uv");
 	glBindAttribLocation(shader.ID, 3, "texid");
+	glBindAttribLocation(shader.ID, 4, "size");  //instanced batches only
+	glBindAttribLocation(shader.ID, 5, "angle");
 	glLinkProgram(shader.ID);
 	glValidateProgram(shader.ID);
+	reflect_uniforms(&shader);
 
 	glUseProgram(0);
 	return shader;
@@ -136,6 +219,7 @@ Shader load_shader_3D(const GLchar* vertexfile, const GLchar* fragmentfile) {
 	glBindAttribLocation(shader.ID, 2, "normal");
 	glLinkProgram(shader.ID);
 	glValidateProgram(shader.ID);
+	reflect_uniforms(&shader);
 
 	glUseProgram(0);
 	return shader;
@@ -155,8 +239,11 @@ Shader load_shader_2D_from_strings(const GLchar* vertexstring, const GLchar* fra
 	glBindAttribLocation(shader.ID, 1, "color");
 	glBindAttribLocation(shader.ID, 2, "uv");
 	glBindAttribLocation(shader.ID, 3, "texid");
+	glBindAttribLocation(shader.ID, 4, "size");  //instanced batches only
+	glBindAttribLocation(shader.ID, 5, "angle");
 	glLinkProgram(shader.ID);
 	glValidateProgram(shader.ID);
+	reflect_uniforms(&shader);
 
 	glUseProgram(0);
 	return shader;
@@ -177,6 +264,7 @@ Shader load_shader_3D_from_strings(const GLchar* vertexstring, const GLchar* fra
 	glBindAttribLocation(shader.ID, 2, "normal");
 	glLinkProgram(shader.ID);
 	glValidateProgram(shader.ID);
+	reflect_uniforms(&shader);
 
 	glUseProgram(0);
 	return shader;
@@ -188,22 +276,62 @@ Shader load_shader_3D_from_strings(const GLchar* vertexstring, const GLchar* fra
 //
 //=============================================
 
+//false if the uniform already holds the value, otherwise it is remembered for next time.
+//glUniform* writes to the program in use, so uploading while another program is bound
+//would cache a value the uniform's own program never got and skip the real upload
+//after it for good. debug builds ask GL which program is in use to catch that.
+INTERNAL inline
+bool uniform_changed(ShaderUniform* uniform, const void* value, u32 size) {
+#ifndef NDEBUG
+	GLint current = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+	BMT_ASSERT((GLuint)current == uniform->program);
+#endif
+	if (uniform->cached && memcmp(uniform->value, value, size) == 0)
+		return false;
+	memcpy(uniform->value, value, size);
+	uniform->cached = true;
+	return true;
+}
+
+//the ShaderUniform overloads take a handle from get_uniform and do nothing for NULL.
+//the handle's shader has to be the one in use, start_shader or begin2D it first.
+
+INTERNAL inline
+void upload_float(ShaderUniform* uniform, f32 value) {
+	if (uniform && uniform_changed(uniform, &value, sizeof(value)))
+		glUniform1f(uniform->location, value);
+}
+
 INTERNAL inline
 void upload_float(Shader shader, const GLchar* name, f32 value) {
-	i32 location = get_uniform_location(shader, name);
-	glUniform1f(location, value);
+	ShaderUniform* uniform = get_uniform(shader, name);
+	if (uniform)
+		upload_float(uniform, value);
+	else
+		glUniform1f(get_uniform_location(shader, name), value);
 }
 
+//arrays are not cached
 INTERNAL inline
 void upload_float_array(Shader shader, const GLchar* name, f32 arr[], i32 count) {
 	i32 location = get_uniform_location(shader, name);
 	glUniform1fv(location, count, arr);
 }
 
+INTERNAL inline
+void upload_int(ShaderUniform* uniform, i32 value) {
+	if (uniform && uniform_changed(uniform, &value, sizeof(value)))
+		glUniform1i(uniform->location, value);
+}
+
 INTERNAL inline
 void upload_int(Shader shader, const GLchar* name, i32 value) {
-	i32 location = get_uniform_location(shader, name);
-	glUniform1i(location, value);
+	ShaderUniform* uniform = get_uniform(shader, name);
+	if (uniform)
+		upload_int(uniform, value);
+	else
+		glUniform1i(get_uniform_location(shader, name), value);
 }
 
 INTERNAL inline
@@ -212,34 +340,74 @@ void upload_int_array(Shader shader, const GLchar* name, i32 arr[], i32 count) {
 	glUniform1iv(location, count, arr);
 }
 
+INTERNAL inline
+void upload_vec2(ShaderUniform* uniform, vec2 vec) {
+	if (uniform && uniform_changed(uniform, &vec, sizeof(vec)))
+		glUniform2f(uniform->location, vec.x, vec.y);
+}
+
 INTERNAL inline
 void upload_vec2(Shader shader, const GLchar* name, vec2 vec) {
-	i32 location = get_uniform_location(shader, name);
-	glUniform2f(location, vec.x, vec.y);
+	ShaderUniform* uniform = get_uniform(shader, name);
+	if (uniform)
+		upload_vec2(uniform, vec);
+	else
+		glUniform2f(get_uniform_location(shader, name), vec.x, vec.y);
+}
+
+INTERNAL inline
+void upload_vec3(ShaderUniform* uniform, vec3 vec) {
+	if (uniform && uniform_changed(uniform, &vec, sizeof(vec)))
+		glUniform3f(uniform->location, vec.x, vec.y, vec.z);
 }
 
 INTERNAL inline
 void upload_vec3(Shader shader, const GLchar* name, vec3 vec) {
-	i32 location = get_uniform_location(shader, name);
-	glUniform3f(location, vec.x, vec.y, vec.z);
+	ShaderUniform* uniform = get_uniform(shader, name);
+	if (uniform)
+		upload_vec3(uniform, vec);
+	else
+		glUniform3f(get_uniform_location(shader, name), vec.x, vec.y, vec.z);
+}
+
+INTERNAL inline
+void upload_vec4(ShaderUniform* uniform, vec4 vec) {
+	if (uniform && uniform_changed(uniform, &vec, sizeof(vec)))
+		glUniform4f(uniform->location, vec.x, vec.y, vec.z, vec.w);
 }
 
 INTERNAL inline
 void upload_vec4(Shader shader, const GLchar* name, vec4 vec) {
-	i32 location = get_uniform_location(shader, name);
-	glUniform4f(location, vec.x, vec.y, vec.z, vec.w);
+	ShaderUniform* uniform = get_uniform(shader, name);
+	if (uniform)
+		upload_vec4(uniform, vec);
+	else
+		glUniform4f(get_uniform_location(shader, name), vec.x, vec.y, vec.z, vec.w);
+}
+
+INTERNAL inline
+void upload_bool(ShaderUniform* uniform, bool value) {
+	upload_float(uniform, value ? 1.0f : 0.0f);
 }
 
 INTERNAL inline
 void upload_bool(Shader shader, const GLchar* name, bool value) {
-	i32 location = get_uniform_location(shader, name);
-	glUniform1f(location, value ? 1 : 0);
+	upload_float(shader, name, value ? 1.0f : 0.0f);
+}
+
+INTERNAL inline
+void upload_mat4(ShaderUniform* uniform, mat4 mat) {
+	if (uniform && uniform_changed(uniform, mat.elements, sizeof(mat.elements)))
+		glUniformMatrix4fv(uniform->location, 1, GL_FALSE, mat.elements);
 }
 
 INTERNAL inline
 void upload_mat4(Shader shader, const GLchar* name, mat4 mat) {
-	i32 location = get_uniform_location(shader, name);
-	glUniformMatrix4fv(location, 1, GL_FALSE, mat.elements);
+	ShaderUniform* uniform = get_uniform(shader, name);
+	if (uniform)
+		upload_mat4(uniform, mat);
+	else
+		glUniformMatrix4fv(get_uniform_location(shader, name), 1, GL_FALSE, mat.elements);
 }
 
 INTERNAL inline
@@ -257,6 +425,7 @@ void dispose_shader(Shader shader) {
 	glDeleteShader(shader.fragshaderID);
 	glDeleteShader(shader.vertexshaderID);
 	glDeleteProgram(shader.ID);
+	free(shader.uniforms);
 }
 
 #endif
\ No newline at end of file
@@ -41,8 +41,20 @@ struct Texture {
 	u64 flip_flag;
 	i32 width;
 	i32 height;
+	f32 region[4]; //u0, v0, u1, v1 of the image inside the GL texture, all of it unless it came from an atlas
+	u16 layer; //counted from 1 when the image is in a layered atlas, 0 for a plain GL_TEXTURE_2D
 };
 
+//for a plain GL_TEXTURE_2D, all of which is the image
+INTERNAL inline
+void set_whole_region(Texture* texture) {
+	texture->layer = 0;
+	texture->region[0] = 0;
+	texture->region[1] = 0;
+	texture->region[2] = 1;
+	texture->region[3] = 1;
+}
+
 INTERNAL inline
 Texture create_blank_texture(u32 width = 0, u32 height = 0) {
 	Texture texture;
@@ -57,6 +69,7 @@ Texture create_blank_texture(u32 width = 0, u32 height = 0) {
 	texture.width = width;
 	texture.height = height;
 	texture.flip_flag = 0;
+	set_whole_region(&texture);
 
 	return texture;
 }
@@ -76,6 +89,7 @@ Texture load_texture(unsigned char* pixels, u32 width, u32 height, u16 param) {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, param);
 	glBindTexture(GL_TEXTURE_2D, 0);
 	texture.flip_flag = 0;
+	set_whole_region(&texture);
 
 	return texture;
 }
@@ -106,6 +120,7 @@ Texture load_texture(const char* filepath, u16 param) {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, param);
 	glBindTexture(GL_TEXTURE_2D, 0);
 	texture.flip_flag = 0;
+	set_whole_region(&texture);
 
 	return texture;
 }
@@ -186,6 +201,7 @@ Framebuffer create_framebuffer(u32 width, u32 height, u16 param, u8 buffertype)
 	buffer.texture.width = width;
 	buffer.texture.height = height;
 	buffer.texture.flip_flag = 0;
+	set_whole_region(&buffer.texture);
 
 	glGenTextures(1, &buffer.texture.ID);
 	glBindTexture(GL_TEXTURE_2D, buffer.texture.ID);
@@ -140,7 +140,7 @@ void init_window(int window_width, int window_height, const char* title, bool fu
 		buttons[i] = -1;
 
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	//glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
 	//END INIT GLFW
 
@@ -152,6 +152,12 @@ void init_window(int window_width, int window_height, const char* title, bool fu
 		glfwWindowHint(GLFW_VISIBLE, false);
 		glfwWindowHint(GLFW_DECORATED, false);
 		glfw_window = glfwCreateWindow(winwidth, winheight, title, NULL, NULL);
+		if (!glfw_window) {
+			//3.0 still runs the vertex batch
+			BMT_LOG(WARNING, "No OpenGL 3.3 context, trying 3.0");
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+			glfw_window = glfwCreateWindow(winwidth, winheight, title, NULL, NULL);
+		}
 		if (!glfw_window) {
 			BMT_LOG(MINOR_ERROR, "Windowed Window failed to be created");
 			glfwTerminate();
@@ -170,6 +176,12 @@ void init_window(int window_width, int window_height, const char* title, bool fu
 	else {
 		glfwWindowHint(GLFW_VISIBLE, false);
 		glfw_window = glfwCreateWindow(winwidth, winheight, title, NULL, NULL);
+		if (!glfw_window) {
+			//3.0 still runs the vertex batch
+			BMT_LOG(WARNING, "No OpenGL 3.3 context, trying 3.0");
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+			glfw_window = glfwCreateWindow(winwidth, winheight, title, NULL, NULL);
+		}
 		if (!glfw_window) {
 			BMT_LOG(MINOR_ERROR, "Windowed Window failed to be created");
 			glfwTerminate();
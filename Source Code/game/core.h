@@ -0,0 +1,118 @@
+#ifndef CORE_H
+#define CORE_H
+
+//what the game code outside drawing needs, the engine's types and maths and
+//nothing that links against it, so the simulation builds without a window
+
+#include "defines.h"
+#include "maths.h"
+#include <limits.h>
+#include <random>
+#include <chrono>
+
+//
+//   CONFIG
+//
+
+//finds (KEY=VALUE) in a config file and copies VALUE into out. false when the
+//file or the key is missing.
+static inline
+bool read_config_value(const char* filename, const char* key, char* out, u32 size) {
+    FILE* file = fopen(filename, "r");
+    if(file == NULL)
+        return false;
+
+    bool found = false;
+    u32 keylength = strlen(key);
+    char line[256];
+    while(!found && fgets(line, sizeof(line), file) != NULL) {
+        char* start = strchr(line, '(');
+        if(start == NULL || strncmp(start + 1, key, keylength) != 0 || start[1 + keylength] != '=')
+            continue;
+        char* value = start + keylength + 2;
+        char* end = strchr(value, ')');
+        if(end == NULL)
+            continue;
+        u32 length = end - value;
+        if(length > size - 1)
+            length = size - 1;
+        memcpy(out, value, length);
+        out[length] = 0;
+        found = true;
+    }
+    fclose(file);
+    return found;
+}
+
+//
+//   RANDOM
+//
+
+//xoshiro128**. everything random in a run draws from one of these, so the same
+//seed gives the same maps and the same ticks on every machine.
+struct Rng {
+    u32 s[4];
+};
+
+static inline
+u32 rotl32(u32 x, i32 k) {
+    return (x << k) | (x >> (32 - k));
+}
+
+//spreads the seed with splitmix64, xoshiro must not start from all zeroes
+static inline
+void seed_rng(Rng* rng, u64 seed) {
+    for(u32 i = 0; i < 4; i += 2) {
+        seed += 0x9E3779B97F4A7C15ull;
+        u64 z = seed;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z ^= z >> 31;
+        rng->s[i] = (u32)z;
+        rng->s[i + 1] = (u32)(z >> 32);
+    }
+}
+
+static inline
+u32 next_random(Rng* rng) {
+    u32* s = rng->s;
+    u32 result = rotl32(s[1] * 5, 7) * 9;
+    u32 t = s[1] << 9;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl32(s[3], 11);
+    return result;
+}
+
+//inclusive on both ends, unbiased
+static inline
+i32 random_int(Rng* rng, i32 min, i32 max) {
+    u32 range = (u32)(max - min) + 1;
+    if(range == 0)
+        return (i32)next_random(rng);
+    u64 m = (u64)next_random(rng) * range;
+    if((u32)m < range) {
+        u32 threshold = (0u - range) % range;
+        while((u32)m < threshold)
+            m = (u64)next_random(rng) * range;
+    }
+    return min + (i32)(m >> 32);
+}
+
+//for when no seed was asked for
+static inline
+u32 random_seed() {
+    std::random_device rd;
+    return rd();
+}
+
+//monotonic, for timing and nothing else
+static inline
+u64 get_nanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
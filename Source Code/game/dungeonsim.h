@@ -0,0 +1,329 @@
+#ifndef DUNGEONSIM_H
+#define DUNGEONSIM_H
+
+#include "core.h"
+#include "map.h"
+#include "flowfield.h"
+#include "pathservice.h"
+#include "unitstore.h"
+#include "steering.h"
+
+//everything the dungeon does from tick to tick. nothing in here draws or reads
+//input, so it builds without the engine for dungeon_bench, see dungeon.h for the
+//scene that draws it.
+
+//
+//   CONSTANTS
+//
+
+const i32 WALL_HP = 100;
+const i32 MINE_COST = 50;
+const i32 EXP_FOR_LEVEL = 100;
+const i32 EXP_MULTIPLIER = 2;
+const i32 MAX_ABILITIES = 5;
+const i32 WANDER_RADIUS = 6;
+const i32 WANDER_CHANCE = 120; //idle units set off on average once per this many ticks
+const f32 SIM_DT = 1.0f / 60; //seconds per tick, what the unit tuning above assumes
+const i32 MAX_TICKS_PER_FRAME = 8; //past this a slow frame drops time instead of catching up
+
+//
+//   STRUCTS
+//
+
+enum DungeonState {
+    DUNGEON_IDLE,
+    DUNGEON_BUILD,
+    DUNGEON_MINE,
+    DUNGEON_SUMMARY,
+};
+
+enum AbilityType {
+    ABILITY_FIREBALL,
+    ABILITY_KICK,
+    ABILITY_CLEAVE,
+    ABILITY_RAISE_SKELETON,
+    ABILITY_SWEEP,
+    ABILITY_WING_ATTACK,
+    ABILITY_BITE,
+    ABILITY_SHADOWBOLT
+};
+
+struct Ability {
+    AbilityType type;
+    u16 levelReq;
+};
+
+struct UnitData {
+    vec2 tilesetpos;
+    u16 stamina_gain;
+    u16 strength_gain;
+    u16 dexterity_gain;
+    u16 intelligence_gain;
+    u16 cost;
+    Ability abilities[MAX_ABILITIES];
+};
+
+const UnitData UNIT_TYPES[UNIT_TYPE_COUNT] = {
+    /*imp*/        { {0, 0}, 1, 1, 1, 0, MINE_COST, { {ABILITY_KICK, 1}                                                                                         } },
+    /*demon*/      { {1, 0}, 2, 2, 1, 0, 100,       { {ABILITY_KICK, 1},       {ABILITY_CLEAVE, 3},        {ABILITY_WING_ATTACK, 5}                             } },
+    /*orc*/        { {2, 0}, 3, 2, 0, 0, 110,       { {ABILITY_BITE, 1},       {ABILITY_CLEAVE, 3},        {ABILITY_SWEEP, 5}                                   } },
+    /*skeleton*/   { {3, 0}, 1, 2, 1, 0, 60,        { {ABILITY_BITE, 1},       {ABILITY_SWEEP, 3},         {ABILITY_KICK, 5},      {ABILITY_RAISE_SKELETON, 12} } },
+    /*dragon*/     { {4, 0}, 3, 3, 2, 3, 200,       { {ABILITY_BITE, 1},       {ABILITY_WING_ATTACK, 3},   {ABILITY_FIREBALL, 5}                                } },
+    /*necromancer*/{ {5, 0}, 2, 0, 0, 3, 150,       { {ABILITY_SHADOWBOLT, 1}, {ABILITY_RAISE_SKELETON, 3}                                                      } },
+
+    /*platino*/    { {0, 1}, 5, 5, 5, 5, 1000,      { {ABILITY_FIREBALL, 1},   {ABILITY_SHADOWBOLT, 2},    {ABILITY_RAISE_SKELETON, 3}, {ABILITY_BITE, 4}, {ABILITY_WING_ATTACK, 5}}}
+};
+
+//nanoseconds the last tick spent in each system. searches run on the path
+//service's threads, their time is summed up on the service instead.
+struct TickProfile {
+    u64 pathfinding; //handing out results and the mine flow field
+    u64 separation; //the unit hash and separation, gathered a unit at a time
+    u64 steering; //steer_units alone
+    u64 orient;
+};
+
+struct DungeonMap {
+    Map map;
+    u32 timer;
+    UnitStore units;
+    UnitHash unithash; //where the units stood at the start of this tick
+    SteerInputs steer;
+    SteerKernel steerkernel;
+    std::vector<vec2> minequeue;
+    std::vector<vec2> dirtytiles; //changed this tick, autotiled at the end of it
+    Pathfinder pathfinder;
+    FlowField mineflow; //distance to the nearest tile an imp can mine from
+    PathService pathservice;
+    std::vector<PathResult> pathresults;
+    std::vector<vec2> scratchpath; //searches write here before the path pool takes it
+    TickProfile profile;
+    Rng rng; //every roll the simulation makes
+
+    //heart of dungeon
+    i32 hp;
+    i32 mana;
+    i32 exp;
+};
+
+//
+//   HELPER FUNCTIONS
+//
+
+//every change to the grid goes through here so the version, the autotiler and
+//the flow field hear about it. cluster graphs catch up from the chunk versions.
+static inline
+void dig_tile(DungeonMap* map, vec2 tile, i32 id) {
+    set_tile(&map->map, tile.x, tile.y, id);
+    map->map.version++;
+    map->dirtytiles.push_back(tile);
+    map->mineflow.dirty = true;
+}
+
+//a tile's graphic depends on its 3x3 neighborhood, so only that much around
+//each changed tile needs redoing
+static inline
+void orient_dirty_tiles(DungeonMap* map) {
+    for(u32 i = 0; i < map->dirtytiles.size(); ++i) {
+        i32 x = map->dirtytiles[i].x;
+        i32 y = map->dirtytiles[i].y;
+        orient_tiles_region(&map->map, x - 1, y - 1, x + 1, y + 1);
+    }
+    map->dirtytiles.clear();
+}
+
+//imps mine from the open tiles beside each queued wall, so those are the goals
+static inline
+void update_mine_flow(DungeonMap* map) {
+    clear_flow_field(&map->mineflow, &map->map);
+    for(u32 i = 0; i < map->minequeue.size(); ++i) {
+        i32 x = map->minequeue[i].x;
+        i32 y = map->minequeue[i].y;
+        seed_flow_field(&map->mineflow, &map->map, x - 1, y);
+        seed_flow_field(&map->mineflow, &map->map, x + 1, y);
+        seed_flow_field(&map->mineflow, &map->map, x, y - 1);
+        seed_flow_field(&map->mineflow, &map->map, x, y + 1);
+    }
+    spread_flow_field(&map->mineflow, &map->map);
+}
+
+static inline
+void add_minequeue_no_copies(vec2 mouse, DungeonMap* map) {
+    vec2 v = V2((i32)(mouse.x / TILE_SIZE), (i32)(mouse.y / TILE_SIZE));
+    bool exists = false;
+    for(u32 i = 0; i < map->minequeue.size(); ++i)
+        if(map->minequeue[i] == v)
+            exists = true;
+
+    if(!exists && tile_blocked(&map->map, v.x, v.y)) {
+        map->minequeue.push_back(v);
+        map->mineflow.dirty = true;
+    }
+}
+
+//
+//   UPDATE GAME SYSTEMS
+//
+
+static inline
+void update_units(DungeonMap* map, u32 slot) {
+    UnitStore* units = &map->units;
+    Unit* unit = &units->info[slot];
+    PathSpan* path = &units->paths[slot];
+    vec2 pos = unit_pos(units, slot);
+
+    if(unit->state == UNIT_MINING) {
+        unit->timer++;
+        if(unit->timer > WALL_HP){
+            unit->timer = 0;
+            clear_path(path);
+            i32 tileindex;
+            vec2 nearest = get_closest_mineable(map->minequeue, pos, &tileindex);
+            if(map->minequeue.size() > 0)
+                map->minequeue.erase(map->minequeue.begin() + tileindex);
+            dig_tile(map, nearest, 8);
+            unit->state = UNIT_IDLE;
+        }
+    }
+
+    //everyone else wanders about the dungeon when there is nothing to do
+    if(unit->type != UNIT_IMP) {
+        if(unit->state == UNIT_IDLE && path->count == 0 && random_int(&map->rng, 0, WANDER_CHANCE) == 0) {
+            i32 x = pos.x / TILE_SIZE;
+            i32 y = pos.y / TILE_SIZE;
+            i32 destx = x + random_int(&map->rng, -WANDER_RADIUS, WANDER_RADIUS);
+            i32 desty = y + random_int(&map->rng, -WANDER_RADIUS, WANDER_RADIUS);
+            clamp(&destx, 0, map->map.width - 1);
+            clamp(&desty, 0, map->map.height - 1);
+
+            bool inside = x >= 0 && y >= 0 && x < map->map.width && y < map->map.height;
+            if(inside && !tile_blocked(&map->map, destx, desty)) {
+                unit->ticket = request_path(&map->pathservice, &map->map, units->handles[slot], V2(x, y), V2(destx, desty), map->pathfinder);
+                unit->state = UNIT_WAITING;
+            }
+        }
+    }
+
+    //idle imps walk down the shared flow field to the nearest queued wall
+    if(unit->type == UNIT_IMP && unit->state == UNIT_IDLE && path->count == 0 && map->minequeue.size() > 0) {
+        u64 start = get_nanoseconds();
+        if(map->mineflow.dirty || map->mineflow.cost == NULL)
+            update_mine_flow(map);
+        follow_flow_field(&map->mineflow, &map->map, {pos.x / TILE_SIZE, pos.y / TILE_SIZE}, &map->scratchpath);
+        set_path(&units->pathpool, path, &map->scratchpath);
+        map->profile.pathfinding += get_nanoseconds() - start;
+    }
+
+}
+
+static inline
+void unit_reached_destination(DungeonMap* map, u32 slot) {
+    Unit* unit = &map->units.info[slot];
+    if(unit->type == UNIT_IMP)
+        unit->state = UNIT_MINING;
+    else {
+        unit->state = UNIT_IDLE;
+    }
+}
+
+//hands finished searches back to the units waiting on them. a path found on an
+//older grid may walk through a wall that has since changed, so those units
+//just ask again.
+static inline
+void apply_path_results(DungeonMap* map) {
+    collect_path_results(&map->pathservice, &map->pathresults);
+    for(u32 i = 0; i < map->pathresults.size(); ++i) {
+        PathResult* result = &map->pathresults[i];
+        u32 slot = unit_slot(&map->units, result->unit);
+        if(slot == NO_UNIT)
+            continue;
+        Unit* unit = &map->units.info[slot];
+        if(unit->state != UNIT_WAITING || unit->ticket != result->ticket)
+            continue;
+
+        if(result->version != map->map.version) {
+            unit->state = UNIT_IDLE;
+            continue;
+        }
+        set_path(&map->units.pathpool, &map->units.paths[slot], &result->path);
+        unit->state = UNIT_WALKING;
+    }
+}
+
+//separation and where each unit is heading, as input for steer_units
+static inline
+void gather_steering(DungeonMap* map) {
+    UnitStore* units = &map->units;
+    u32 count = unit_count(units);
+    build_unit_hash(&map->unithash, units->x.data(), units->y.data(), count);
+    resize_steer_inputs(&map->steer, count);
+    for(u32 i = 0; i < count; ++i) {
+        PathSpan* path = &units->paths[i];
+        map->steer.seeking[i] = path->count > 0 ? -1 : 0;
+        if(path->count > 0) {
+            vec2 next = path_back(&units->pathpool, path);
+            vec2 seperation = calculate_seperation(&map->map, &map->unithash, unit_pos(units, i));
+            map->steer.tx[i] = next.x * TILE_SIZE;
+            map->steer.ty[i] = next.y * TILE_SIZE;
+            map->steer.sx[i] = seperation.x;
+            map->steer.sy[i] = seperation.y;
+        }
+    }
+}
+
+//
+//   MAIN DUNGEON GAME LOOP
+//
+
+//advances the dungeon by dt seconds. touches no gl state and reads no input,
+//so it runs the same with or without a window. timers count ticks, so dt
+//should be SIM_DT unless the tuning changes with it.
+static inline
+void simulate_tick(DungeonMap* map, f32 dt) {
+    u64 start = get_nanoseconds();
+    apply_path_results(map);
+    map->timer++;
+
+    u64 now = get_nanoseconds();
+    map->profile.pathfinding = now - start;
+    start = now;
+    UnitStore* units = &map->units;
+    gather_steering(map);
+    now = get_nanoseconds();
+    map->profile.separation = now - start;
+    start = now;
+    steer_units(units, &map->steer, map->steerkernel, dt / SIM_DT);
+    map->profile.steering = get_nanoseconds() - start;
+    for(u32 i = 0; i < unit_count(units); ++i) {
+        update_units(map, i);
+
+        //check for reaching destination
+        PathSpan* path = &units->paths[i];
+        vec2 pos = unit_pos(units, i);
+        if(path->count > 0) {
+            vec2 next = path_back(&units->pathpool, path);
+            if(getDistanceE(pos.x, pos.y, (next.x * TILE_SIZE), (next.y * TILE_SIZE)) < (TILE_SIZE/1.5)) {
+                //reached destination
+                if(abs(units->vx[i]) < VELOCITY_MINIMUM && abs(units->vy[i]) < VELOCITY_MINIMUM && !tile_blocked(&map->map, pos.x / TILE_SIZE, pos.y / TILE_SIZE) && path->count == 1) {
+                    clear_path(path);
+                    units->vx[i] = 0;
+                    units->vy[i] = 0;
+                    units->fx[i] = 0;
+                    units->fy[i] = 0;
+
+                    unit_reached_destination(map, i);
+                }
+
+                if(path->count > 1)
+                    pop_path(path);
+            }
+        }
+    }
+    tidy_unit_paths(units);
+
+    start = get_nanoseconds();
+    orient_dirty_tiles(map);
+    map->profile.orient = get_nanoseconds() - start;
+}
+
+#endif
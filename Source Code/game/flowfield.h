@@ -0,0 +1,154 @@
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include "core.h"
+#include "map.h"
+
+//
+//   FLOW FIELDS
+//
+
+//distance from every tile to the nearest of a set of goal tiles, filled in by
+//one multi-source dijkstra. any number of units can then walk downhill to
+//their closest goal without running a search of their own.
+
+const u32 FLOW_UNREACHED = 0xFFFFFFFF;
+
+struct FlowField {
+    u32* cost;
+    u32 size;
+    std::vector<u64> open; //cost << 32 | cell
+    bool dirty;
+};
+
+static inline
+void clear_flow_field(FlowField* field, Map* map) {
+    u32 size = map_cells(map);
+    if(field->size != size) {
+        free(field->cost);
+        field->cost = (u32*)malloc(sizeof(u32) * size);
+        field->size = size;
+    }
+    for(u32 i = 0; i < size; ++i)
+        field->cost[i] = FLOW_UNREACHED;
+    field->open.clear();
+}
+
+//marks (x, y) as a goal. call between clear_flow_field and spread_flow_field.
+static inline
+void seed_flow_field(FlowField* field, Map* map, i32 x, i32 y) {
+    if(x < 0 || y < 0 || x >= map->width || y >= map->height)
+        return;
+    u32 cell = tile_index(map, x, y);
+    if(cell_blocked(map, cell) || field->cost[cell] == 0)
+        return;
+    field->cost[cell] = 0;
+    field->open.push_back(cell);
+}
+
+static inline
+void relax_flow(FlowField* field, Map* map, u32 cost, i32 x, i32 y, i32 step) {
+    u32 cell = tile_index(map, x, y);
+    if(cost + step >= field->cost[cell])
+        return;
+    field->cost[cell] = cost + step;
+    field->open.push_back(((u64)(cost + step) << 32) | cell);
+    std::push_heap(field->open.begin(), field->open.end(), std::greater<u64>());
+}
+
+static inline
+void spread_flow_field(FlowField* field, Map* map) {
+    std::make_heap(field->open.begin(), field->open.end(), std::greater<u64>());
+    while(field->open.size() > 0) {
+        std::pop_heap(field->open.begin(), field->open.end(), std::greater<u64>());
+        u64 key = field->open.back();
+        field->open.pop_back();
+        u32 cost = key >> 32;
+        u32 cell = key & 0xFFFFFFFF;
+        if(cost > field->cost[cell])
+            continue;
+
+        i32 x, y;
+        tile_position(map, cell, &x, &y);
+        bool left = path_walkable(map, x - 1, y, -1);
+        bool right = path_walkable(map, x + 1, y, -1);
+        bool up = path_walkable(map, x, y - 1, -1);
+        bool down = path_walkable(map, x, y + 1, -1);
+
+        if(left)  relax_flow(field, map, cost, x - 1, y, STRAIGHT_COST);
+        if(right) relax_flow(field, map, cost, x + 1, y, STRAIGHT_COST);
+        if(up)    relax_flow(field, map, cost, x, y - 1, STRAIGHT_COST);
+        if(down)  relax_flow(field, map, cost, x, y + 1, STRAIGHT_COST);
+
+#ifdef DIAGONAL_ASTAR
+        if(up && left && path_walkable(map, x - 1, y - 1, -1))    relax_flow(field, map, cost, x - 1, y - 1, DIAGONAL_COST);
+        if(up && right && path_walkable(map, x + 1, y - 1, -1))   relax_flow(field, map, cost, x + 1, y - 1, DIAGONAL_COST);
+        if(down && left && path_walkable(map, x - 1, y + 1, -1))  relax_flow(field, map, cost, x - 1, y + 1, DIAGONAL_COST);
+        if(down && right && path_walkable(map, x + 1, y + 1, -1)) relax_flow(field, map, cost, x + 1, y + 1, DIAGONAL_COST);
+#endif
+    }
+    field->dirty = false;
+}
+
+//walks downhill from start to the nearest goal and writes the tiles into path
+//the same way pathfind_astar does, goal first. false if no goal is reachable.
+static inline
+bool follow_flow_field(FlowField* field, Map* map, vec2 start, std::vector<vec2>* path) {
+    i32 x = start.x;
+    i32 y = start.y;
+    path->clear();
+    if(x < 0 || y < 0 || x >= map->width || y >= map->height || field->cost[tile_index(map, x, y)] == FLOW_UNREACHED)
+        return false;
+
+    path->push_back({(f32)x, (f32)y});
+    while(field->cost[tile_index(map, x, y)] > 0) {
+        i32 bestx = x;
+        i32 besty = y;
+        u32 best = field->cost[tile_index(map, x, y)];
+        for(i32 dy = -1; dy <= 1; ++dy) {
+            for(i32 dx = -1; dx <= 1; ++dx) {
+                if(dx == 0 && dy == 0)
+                    continue;
+                if(dx != 0 && dy != 0) {
+#ifdef DIAGONAL_ASTAR
+                    if(!path_walkable(map, x + dx, y, -1) || !path_walkable(map, x, y + dy, -1))
+                        continue;
+#else
+                    continue;
+#endif
+                }
+                if(!path_walkable(map, x + dx, y + dy, -1))
+                    continue;
+                u32 cost = field->cost[tile_index(map, x + dx, y + dy)];
+                if(cost < best) {
+                    best = cost;
+                    bestx = x + dx;
+                    besty = y + dy;
+                }
+            }
+        }
+        //only happens if the grid changed since the field was spread
+        if(bestx == x && besty == y) {
+            path->clear();
+            return false;
+        }
+        x = bestx;
+        y = besty;
+        path->push_back({(f32)x, (f32)y});
+    }
+
+    std::reverse(path->begin(), path->end());
+    return true;
+}
+
+static inline
+void dispose_flow_field(FlowField* field) {
+    free(field->cost);
+    field->cost = NULL;
+    field->size = 0;
+}
+
+#endif
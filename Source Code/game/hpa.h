@@ -0,0 +1,484 @@
+#ifndef HPA_H
+#define HPA_H
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include "core.h"
+#include "map.h"
+
+//
+//   HIERARCHICAL PATHFINDING
+//
+
+//the map is cut into CLUSTER_SIZE x CLUSTER_SIZE clusters. every open stretch
+//of a cluster border gets one or two entrance nodes on each side, and each
+//cluster caches the walking distance between its own entrances. long searches
+//run over those entrances and only the hops between them are searched on the
+//tile grid.
+//
+//a cluster is one map chunk, so the map's chunk versions tell which clusters
+//went stale. searches bring the graph up to date first, see repair_cluster_graph.
+
+const i32 CLUSTER_SIZE = CHUNK_SIZE;
+const u32 MAX_CLUSTER_NODES = 4 * (CLUSTER_SIZE / 2); //at most every other tile of each border
+const i32 LONG_ENTRANCE = 6; //open stretches this long get an entrance at each end
+const u16 NO_ROUTE = 0xFFFF;
+const u32 MAX_DEST_CLUSTERS = 4; //dest's own and those of the tiles it can be stepped onto from
+
+struct ClusterNode {
+    i32 x;
+    i32 y;
+    i32 partnerx; //tile on the other side of the border
+    i32 partnery;
+    u32 neighbor; //cluster the partner tile is in
+};
+
+struct Cluster {
+    i32 x;
+    i32 y;
+    i32 width;
+    i32 height;
+    std::vector<ClusterNode> nodes;
+    std::vector<u16> dist; //nodes.size() squared, NO_ROUTE if not connected inside the cluster
+};
+
+struct AbstractNode {
+    i32 gcost;
+    u32 parent;
+    u32 generation;
+    bool closed;
+};
+
+struct AbstractOpen {
+    i32 fcost;
+    i32 gcost;
+    u32 id;
+};
+
+//heap order for the open list: lowest f first, ties to the node furthest along
+static inline
+bool abstract_open_after(const AbstractOpen& a, const AbstractOpen& b) {
+    if(a.fcost != b.fcost)
+        return a.fcost > b.fcost;
+    return a.gcost < b.gcost;
+}
+
+struct ClusterGraph {
+    u32 width; //in clusters
+    u32 height;
+    std::vector<Cluster> clusters;
+    std::vector<u32> chunkversions; //the map's chunk versions the clusters were built from
+    std::vector<u8> changed; //chunks that moved on since, scratch for repair_cluster_graph
+
+    //scratch for searches over the graph. entrance nodes are numbered
+    //cluster * MAX_CLUSTER_NODES + local index, then the start and dest.
+    std::vector<AbstractNode> search;
+    std::vector<AbstractOpen> open;
+    std::vector<u32> route;
+    std::vector<vec2> segment;
+    u32 generation;
+    u16 startcost[MAX_CLUSTER_NODES];
+    u16 directcost; //start to dest without leaving the start cluster, NO_ROUTE if there is no such way
+    u32 destclusters[MAX_DEST_CLUSTERS];
+    u32 destclustercount;
+    u16 destcost[MAX_DEST_CLUSTERS][MAX_CLUSTER_NODES];
+};
+
+//walking distance from (x, y) to every tile of the cluster, without leaving
+//it. out is indexed by local tile and must hold CLUSTER_SIZE * CLUSTER_SIZE.
+static inline
+void cluster_distances(Map* map, Cluster* cluster, i32 x, i32 y, i32 destcell, u16* out) {
+    const u32 AREA = CLUSTER_SIZE * CLUSTER_SIZE;
+    u32 heap[AREA * 8];
+    u32 count = 0;
+
+    for(u32 i = 0; i < AREA; ++i)
+        out[i] = NO_ROUTE;
+
+    //keys are cost << 8 | local tile, so the smallest key is the closest tile
+    u32 local = (x - cluster->x) + (y - cluster->y) * CLUSTER_SIZE;
+    out[local] = 0;
+    heap[count++] = local;
+
+    while(count > 0) {
+        std::pop_heap(heap, heap + count, std::greater<u32>());
+        u32 key = heap[--count];
+        u32 cost = key >> 8;
+        local = key & 0xFF;
+        if(cost > out[local])
+            continue;
+
+        i32 tx = cluster->x + local % CLUSTER_SIZE;
+        i32 ty = cluster->y + local / CLUSTER_SIZE;
+        for(i32 dy = -1; dy <= 1; ++dy) {
+            for(i32 dx = -1; dx <= 1; ++dx) {
+                if(dx == 0 && dy == 0)
+                    continue;
+                i32 nx = tx + dx;
+                i32 ny = ty + dy;
+                if(nx < cluster->x || ny < cluster->y || nx >= cluster->x + cluster->width || ny >= cluster->y + cluster->height)
+                    continue;
+                if(!path_walkable(map, nx, ny, destcell))
+                    continue;
+
+                i32 step = STRAIGHT_COST;
+                if(dx != 0 && dy != 0) {
+#ifdef DIAGONAL_ASTAR
+                    if(!path_walkable(map, nx, ty, destcell) || !path_walkable(map, tx, ny, destcell))
+                        continue;
+                    step = DIAGONAL_COST;
+#else
+                    continue;
+#endif
+                }
+
+                u32 next = (nx - cluster->x) + (ny - cluster->y) * CLUSTER_SIZE;
+                if(cost + step < out[next]) {
+                    out[next] = cost + step;
+                    heap[count++] = ((cost + step) << 8) | next;
+                    std::push_heap(heap, heap + count, std::greater<u32>());
+                }
+            }
+        }
+    }
+}
+
+//walks one border of a cluster starting at (x, y) and stepping (stepx,
+//stepy). (dx, dy) points across the border into the neighbor. both clusters
+//walk the shared border in the same order, so they agree on the entrances.
+static inline
+void add_border_nodes(Map* map, Cluster* cluster, u32 neighbor, i32 x, i32 y, i32 dx, i32 dy, i32 stepx, i32 stepy, i32 length) {
+    i32 run = 0;
+    for(i32 i = 0; i <= length; ++i) {
+        i32 tx = x + stepx * i;
+        i32 ty = y + stepy * i;
+        bool open = i < length &&
+                    !tile_blocked(map, tx, ty) &&
+                    !tile_blocked(map, tx + dx, ty + dy);
+        if(open) {
+            run++;
+            continue;
+        }
+        if(run == 0)
+            continue;
+
+        i32 first = i - run;
+        i32 last = i - 1;
+        if(run < LONG_ENTRANCE)
+            first = last = first + run / 2;
+
+        ClusterNode node;
+        node.x = x + stepx * first;
+        node.y = y + stepy * first;
+        node.partnerx = node.x + dx;
+        node.partnery = node.y + dy;
+        node.neighbor = neighbor;
+        cluster->nodes.push_back(node);
+        if(last != first) {
+            node.x = x + stepx * last;
+            node.y = y + stepy * last;
+            node.partnerx = node.x + dx;
+            node.partnery = node.y + dy;
+            cluster->nodes.push_back(node);
+        }
+        run = 0;
+    }
+}
+
+//recomputes the entrances and cached distances of one cluster from the grid
+static inline
+void rebuild_cluster(ClusterGraph* graph, Map* map, u32 index) {
+    Cluster* cluster = &graph->clusters[index];
+    u32 cx = index % graph->width;
+    u32 cy = index / graph->width;
+    i32 x0 = cluster->x;
+    i32 y0 = cluster->y;
+    i32 x1 = cluster->x + cluster->width - 1;
+    i32 y1 = cluster->y + cluster->height - 1;
+
+    cluster->nodes.clear();
+    if(cy > 0)
+        add_border_nodes(map, cluster, index - graph->width, x0, y0, 0, -1, 1, 0, cluster->width);
+    if(cy < graph->height - 1)
+        add_border_nodes(map, cluster, index + graph->width, x0, y1, 0, 1, 1, 0, cluster->width);
+    if(cx > 0)
+        add_border_nodes(map, cluster, index - 1, x0, y0, -1, 0, 0, 1, cluster->height);
+    if(cx < graph->width - 1)
+        add_border_nodes(map, cluster, index + 1, x1, y0, 1, 0, 0, 1, cluster->height);
+
+    u32 count = cluster->nodes.size();
+    cluster->dist.assign(count * count, NO_ROUTE);
+
+    u16 costs[CLUSTER_SIZE * CLUSTER_SIZE];
+    for(u32 i = 0; i < count; ++i) {
+        ClusterNode* from = &cluster->nodes[i];
+        cluster_distances(map, cluster, from->x, from->y, -1, costs);
+        for(u32 j = 0; j < count; ++j) {
+            ClusterNode* to = &cluster->nodes[j];
+            cluster->dist[i * count + j] = costs[(to->x - cluster->x) + (to->y - cluster->y) * CLUSTER_SIZE];
+        }
+    }
+}
+
+static inline
+void build_cluster_graph(ClusterGraph* graph, Map* map) {
+    graph->width = (map->width + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    graph->height = (map->height + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    graph->clusters.clear();
+    graph->clusters.resize(graph->width * graph->height);
+
+    for(u32 i = 0; i < graph->clusters.size(); ++i) {
+        Cluster* cluster = &graph->clusters[i];
+        cluster->x = (i % graph->width) * CLUSTER_SIZE;
+        cluster->y = (i / graph->width) * CLUSTER_SIZE;
+        cluster->width = std::min(CLUSTER_SIZE, map->width - cluster->x);
+        cluster->height = std::min(CLUSTER_SIZE, map->height - cluster->y);
+    }
+    for(u32 i = 0; i < graph->clusters.size(); ++i)
+        rebuild_cluster(graph, map, i);
+
+    graph->chunkversions.assign(map->chunkversions, map->chunkversions + graph->clusters.size());
+    graph->changed.assign(graph->clusters.size(), 0);
+    graph->search.assign(graph->clusters.size() * MAX_CLUSTER_NODES + 2, AbstractNode{0, NO_PARENT, 0, false});
+    graph->generation = 0;
+}
+
+//brings the graph up to date with map, building it the first time. a cluster
+//is rebuilt when its chunk changed, or a chunk across one of its borders did,
+//since the entrances on a border depend on the tiles either side of it.
+static inline
+void repair_cluster_graph(ClusterGraph* graph, Map* map) {
+    if(graph->clusters.size() == 0 || graph->width != (u32)map->chunkswide || graph->height != (u32)map->chunkshigh) {
+        build_cluster_graph(graph, map);
+        return;
+    }
+
+    bool any = false;
+    for(u32 i = 0; i < graph->clusters.size(); ++i) {
+        graph->changed[i] = graph->chunkversions[i] != map->chunkversions[i];
+        graph->chunkversions[i] = map->chunkversions[i];
+        any = any || graph->changed[i];
+    }
+    if(!any)
+        return;
+
+    for(u32 i = 0; i < graph->clusters.size(); ++i) {
+        u32 cx = i % graph->width;
+        u32 cy = i / graph->width;
+        if(graph->changed[i] ||
+           (cx > 0 && graph->changed[i - 1]) ||
+           (cx < graph->width - 1 && graph->changed[i + 1]) ||
+           (cy > 0 && graph->changed[i - graph->width]) ||
+           (cy < graph->height - 1 && graph->changed[i + graph->width]))
+            rebuild_cluster(graph, map, i);
+    }
+}
+
+static inline
+u32 cluster_at(ClusterGraph* graph, i32 x, i32 y) {
+    return (x / CLUSTER_SIZE) + (y / CLUSTER_SIZE) * graph->width;
+}
+
+static inline
+vec2 abstract_node_pos(ClusterGraph* graph, u32 id, vec2 start, vec2 dest) {
+    u32 startid = graph->clusters.size() * MAX_CLUSTER_NODES;
+    if(id == startid)
+        return start;
+    if(id == startid + 1)
+        return dest;
+    ClusterNode* node = &graph->clusters[id / MAX_CLUSTER_NODES].nodes[id % MAX_CLUSTER_NODES];
+    return {(f32)node->x, (f32)node->y};
+}
+
+static inline
+void open_abstract_node(ClusterGraph* graph, u32 from, u32 id, i32 cost, vec2 pos, vec2 dest) {
+    AbstractNode* node = &graph->search[id];
+    i32 g = graph->search[from].gcost + cost;
+    if(node->generation == graph->generation && (node->closed || node->gcost <= g))
+        return;
+
+    node->generation = graph->generation;
+    node->closed = false;
+    node->gcost = g;
+    node->parent = from;
+
+    //stale entries are skipped when popped, so there is no decrease-key
+    graph->open.push_back({g + path_heuristic(pos.x, pos.y, dest.x, dest.y), g, id});
+    std::push_heap(graph->open.begin(), graph->open.end(), abstract_open_after);
+}
+
+//links the entrances of the cluster (x, y) is in to dest, at their distance
+//from (x, y) plus step. startcosts are the start's distances over the start
+//cluster, for when (x, y) is in it.
+static inline
+void hook_dest(ClusterGraph* graph, Map* map, i32 x, i32 y, i32 destcell, u16 step, u32 startcluster, u16* startcosts) {
+    u32 c = cluster_at(graph, x, y);
+    Cluster* cluster = &graph->clusters[c];
+    u32 slot = 0;
+    while(slot < graph->destclustercount && graph->destclusters[slot] != c)
+        slot++;
+    if(slot == graph->destclustercount) {
+        graph->destclusters[slot] = c;
+        graph->destclustercount++;
+        for(u32 i = 0; i < cluster->nodes.size(); ++i)
+            graph->destcost[slot][i] = NO_ROUTE;
+    }
+
+    u16 costs[CLUSTER_SIZE * CLUSTER_SIZE];
+    cluster_distances(map, cluster, x, y, destcell, costs);
+    for(u32 i = 0; i < cluster->nodes.size(); ++i) {
+        u16 cost = costs[(cluster->nodes[i].x - cluster->x) + (cluster->nodes[i].y - cluster->y) * CLUSTER_SIZE];
+        if(cost != NO_ROUTE && cost + step < graph->destcost[slot][i])
+            graph->destcost[slot][i] = cost + step;
+    }
+
+    u16 direct = startcosts[(x - cluster->x) + (y - cluster->y) * CLUSTER_SIZE];
+    if(c == startcluster && direct != NO_ROUTE && direct + step < graph->directcost)
+        graph->directcost = direct + step;
+}
+
+//finds the chain of entrances from start to dest. false if there is none.
+static inline
+bool search_cluster_graph(ClusterGraph* graph, Map* map, vec2 start, vec2 dest) {
+    u32 startid = graph->clusters.size() * MAX_CLUSTER_NODES;
+    u32 destid = startid + 1;
+    u32 startcluster = cluster_at(graph, start.x, start.y);
+    i32 destx = dest.x;
+    i32 desty = dest.y;
+    i32 destcell = tile_index(map, destx, desty);
+
+    //hook the start into the entrances of its own cluster
+    u16 startcosts[CLUSTER_SIZE * CLUSTER_SIZE];
+    Cluster* cluster = &graph->clusters[startcluster];
+    cluster_distances(map, cluster, start.x, start.y, destcell, startcosts);
+    for(u32 i = 0; i < cluster->nodes.size(); ++i)
+        graph->startcost[i] = startcosts[(cluster->nodes[i].x - cluster->x) + (cluster->nodes[i].y - cluster->y) * CLUSTER_SIZE];
+
+    //and the dest into its own. a wall is reached from a tile beside it, which
+    //can be across a border with no entrance on it, since the wall itself
+    //breaks the open run there. so a wall is hooked in from the clusters of
+    //the tiles it can be stepped onto from as well.
+    graph->directcost = NO_ROUTE;
+    graph->destclustercount = 0;
+    hook_dest(graph, map, destx, desty, destcell, 0, startcluster, startcosts);
+    if(cell_blocked(map, destcell)) {
+        const i32 dx[8] = {-1, 1, 0, 0, -1, 1, -1, 1};
+        const i32 dy[8] = {0, 0, -1, 1, -1, -1, 1, 1};
+#ifdef DIAGONAL_ASTAR
+        const i32 directions = 8;
+#else
+        const i32 directions = 4;
+#endif
+        for(i32 i = 0; i < directions; ++i) {
+            i32 x = destx + dx[i];
+            i32 y = desty + dy[i];
+            if(!path_walkable(map, x, y, destcell) || cluster_at(graph, x, y) == cluster_at(graph, destx, desty))
+                continue;
+            //diagonals may not cut the corner of a wall
+            if(i >= 4 && (!path_walkable(map, destx, y, destcell) || !path_walkable(map, x, desty, destcell)))
+                continue;
+            hook_dest(graph, map, x, y, destcell, i < 4 ? STRAIGHT_COST : DIAGONAL_COST, startcluster, startcosts);
+        }
+    }
+
+    graph->generation++;
+    graph->open.clear();
+    AbstractNode* first = &graph->search[startid];
+    first->generation = graph->generation;
+    first->closed = false;
+    first->gcost = 0;
+    first->parent = NO_PARENT;
+    graph->open.push_back({0, 0, startid});
+
+    while(graph->open.size() > 0) {
+        std::pop_heap(graph->open.begin(), graph->open.end(), abstract_open_after);
+        u32 current = graph->open.back().id;
+        graph->open.pop_back();
+        AbstractNode* node = &graph->search[current];
+        if(node->closed)
+            continue;
+        node->closed = true;
+
+        if(current == destid) {
+            graph->route.clear();
+            for(u32 id = destid; id != NO_PARENT; id = graph->search[id].parent)
+                graph->route.push_back(id);
+            return true;
+        }
+
+        if(current == startid) {
+            if(graph->directcost != NO_ROUTE)
+                open_abstract_node(graph, current, destid, graph->directcost, dest, dest);
+            cluster = &graph->clusters[startcluster];
+            for(u32 i = 0; i < cluster->nodes.size(); ++i)
+                if(graph->startcost[i] != NO_ROUTE)
+                    open_abstract_node(graph, current, startcluster * MAX_CLUSTER_NODES + i, graph->startcost[i], abstract_node_pos(graph, startcluster * MAX_CLUSTER_NODES + i, start, dest), dest);
+            continue;
+        }
+
+        u32 c = current / MAX_CLUSTER_NODES;
+        u32 local = current % MAX_CLUSTER_NODES;
+        cluster = &graph->clusters[c];
+        u32 count = cluster->nodes.size();
+        ClusterNode* from = &cluster->nodes[local];
+
+        for(u32 i = 0; i < graph->destclustercount; ++i)
+            if(graph->destclusters[i] == c && graph->destcost[i][local] != NO_ROUTE)
+                open_abstract_node(graph, current, destid, graph->destcost[i][local], dest, dest);
+
+        for(u32 i = 0; i < count; ++i) {
+            u16 cost = cluster->dist[local * count + i];
+            if(i != local && cost != NO_ROUTE)
+                open_abstract_node(graph, current, c * MAX_CLUSTER_NODES + i, cost, {(f32)cluster->nodes[i].x, (f32)cluster->nodes[i].y}, dest);
+        }
+
+        //step across the border to the matching entrance
+        Cluster* other = &graph->clusters[from->neighbor];
+        for(u32 i = 0; i < other->nodes.size(); ++i) {
+            ClusterNode* to = &other->nodes[i];
+            if(to->x == from->partnerx && to->y == from->partnery && to->partnerx == from->x && to->partnery == from->y) {
+                open_abstract_node(graph, current, from->neighbor * MAX_CLUSTER_NODES + i, STRAIGHT_COST, {(f32)to->x, (f32)to->y}, dest);
+                break;
+            }
+        }
+    }
+
+    return false;
+}
+
+//same contract as pathfind_astar. searches inside one cluster, and anything
+//the graph cannot route, fall back to a plain A* over the grid. grid is the
+//scratch for those and for the hops between entrances.
+static inline
+void pathfind_hpa(ClusterGraph* graph, Map* map, PathGrid* grid, vec2 start, vec2 dest, std::vector<vec2>* path) {
+    if (start.x < 0 || start.y < 0 || start.x > map->width - 1 || start.y > map->height - 1)
+        BMT_LOG(FATAL_ERROR, "vec2 start was out of bounds. start = (%f, %f)", start.x, start.y);
+    if (dest.x < 0 || dest.y < 0 || dest.x > map->width - 1 || dest.y > map->height - 1)
+        BMT_LOG(FATAL_ERROR, "vec2 dest was out of bounds. dest = (%f, %f)", dest.x, dest.y);
+
+    repair_cluster_graph(graph, map);
+
+    if(cluster_at(graph, start.x, start.y) == cluster_at(graph, dest.x, dest.y) || !search_cluster_graph(graph, map, start, dest)) {
+        pathfind_astar(map, grid, start, dest, path);
+        return;
+    }
+
+    //route runs dest to start like the paths do. refine each hop on the grid
+    //and join them, dropping the tile the hops share.
+    path->clear();
+    for(u32 i = 0; i + 1 < graph->route.size(); ++i) {
+        vec2 to = abstract_node_pos(graph, graph->route[i], start, dest);
+        vec2 from = abstract_node_pos(graph, graph->route[i + 1], start, dest);
+        pathfind_astar(map, grid, from, to, &graph->segment);
+        path->insert(path->end(), graph->segment.begin(), graph->segment.end() - 1);
+    }
+    path->push_back(start);
+}
+
+static inline
+void pathfind_hpa(ClusterGraph* graph, Map* map, vec2 start, vec2 dest, std::vector<vec2>* path) {
+    pathfind_hpa(graph, map, get_path_grid(map), start, dest, path);
+}
+
+#endif
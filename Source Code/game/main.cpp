@@ -1,6 +1,9 @@
+#include <chrono>
+#include <thread>
 #include "bahamut.h"
 #include "utils.h"
 #include "map.h"
+#include "mapgen.h"
 #include "dungeon.h"
 
 enum MainState {
@@ -29,16 +32,16 @@ struct TitleScene {
 };
 
 static inline
-TitleScene load_title_scene() {
+TitleScene load_title_scene(TextureAtlas* atlas) {
     TitleScene scene = {0};
     
-    scene.big = load_neighbors_font(3);
-    scene.small = load_neighbors_font(2);
-    scene.mountain1 = load_texture("data/art/mountain1.png", GL_NEAREST);
-    scene.mountain2 = load_texture("data/art/mountain2.png", GL_NEAREST);
-    scene.mountain3 = load_texture("data/art/mountain3.png", GL_NEAREST);
-    scene.sky = load_texture("data/art/sky.png", GL_NEAREST);
-    scene.scroll = load_texture("data/art/scroll.png", GL_NEAREST);
+    scene.big = load_neighbors_font(atlas, 3);
+    scene.small = load_neighbors_font(atlas, 2);
+    scene.mountain1 = load_texture(atlas, "data/art/mountain1.png");
+    scene.mountain2 = load_texture(atlas, "data/art/mountain2.png");
+    scene.mountain3 = load_texture(atlas, "data/art/mountain3.png");
+    scene.sky = load_texture(atlas, "data/art/sky.png");
+    scene.scroll = load_texture(atlas, "data/art/scroll.png");
 
     scene.bgm = load_sound("data/sound/Soliloquy.wav");
     set_sound_looping(scene.bgm, true);
@@ -49,12 +52,6 @@ TitleScene load_title_scene() {
 
 static inline
 void dispose_title_scene(TitleScene* scene) {
-    dispose_texture(scene->mountain1);
-    dispose_texture(scene->mountain2);
-    dispose_texture(scene->mountain3);
-    dispose_texture(scene->sky);
-    dispose_texture(scene->scroll);
-
     dispose_sound(scene->bgm);
 }
 
@@ -120,55 +117,149 @@ void title_screen(RenderBatch* batch, TitleScene* scene, MainState* mainstate, v
     //draw_texture(batch, scene->scroll, 100, 100);
 }
 
-int main() {
-    printf("\n/////////////////////////////////\nPROGRAM STARTING\n/////////////////////////////////\n\n");
-    init_window(640, 360, "Monster Manager", false, true, true);
-    init_audio();
-    set_fps_cap(60);
-    set_master_volume(100);
-    set_vsync(true);
-    set_mouse_state(MOUSE_HIDDEN);
-
-    RenderBatch * batch = &create_batch();
-    Shader basic = load_default_shader_2D();
-    MainState state = GOTO_TITLE;
+//count spawn points on the open tiles nearest start, walking out over the floor so
+//they stay in the start room. a room too small for everyone hands its tiles
+//out again, jittered a few pixels so the extra units don't pile onto one point.
+static inline
+void spawn_points(DungeonMap* map, vec2 start, u32 count, std::vector<vec2>* points) {
+    Map* grid = &map->map;
+    std::vector<u8> seen(grid->width * grid->height, 0);
+    std::vector<vec2> tiles;
+    tiles.push_back(start);
+    seen[(i32)start.x + (i32)start.y * grid->width] = 1;
+    for(u32 i = 0; i < tiles.size() && tiles.size() < count; ++i) {
+        const i32 STEPS[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+        for(u32 s = 0; s < 4; ++s) {
+            i32 x = tiles[i].x + STEPS[s][0];
+            i32 y = tiles[i].y + STEPS[s][1];
+            if(x < 0 || y < 0 || x >= grid->width || y >= grid->height || seen[x + y * grid->width] || tile_blocked(grid, x, y))
+                continue;
+            seen[x + y * grid->width] = 1;
+            tiles.push_back(V2(x, y));
+        }
+    }
 
-    DungeonMap dungeonMap = {0};
-    dungeonMap.hp = 100;
-    dungeonMap.mana = 50;
-    dungeonMap.exp = 15;
-    dungeonMap.map = load_random_map(100, 90);
-    
-    Texture cursor = load_texture("data/art/cursor.png", GL_NEAREST);
+    points->clear();
+    for(u32 i = 0; i < count; ++i) {
+        vec2 point = tiles[i % tiles.size()] * TILE_SIZE;
+        if(i >= tiles.size())
+            point = point + V2(random_int(&map->rng, -4, 4), random_int(&map->rng, -4, 4));
+        points->push_back(point);
+    }
+}
 
+//the same seed in lockstep replays the same dungeon tick for tick
+static inline
+void setup_dungeon(DungeonMap* map, u32 seed, bool lockstep) {
+    map->hp = 100;
+    map->mana = 50;
+    map->exp = 15;
+    seed_rng(&map->rng, seed);
+    DungeonGenStats gen;
+    map->map = generate_dungeon(100, 90, 0, &map->rng, &gen);
+    map->pathfinder = PATHFINDER_JPS;
+    start_path_service(&map->pathservice, 0, lockstep);
+    BMT_LOG(INFO, "dungeon seed %u, %u rooms and %u caves in %.2f ms", seed, gen.rooms, gen.caves, gen.seconds * 1000);
+    map->steerkernel = detect_steer_kernel();
+    BMT_LOG(INFO, "steering with the %s kernel", steer_kernel_name(map->steerkernel));
+
+    //one floor tile each, seperation pushes nothing apart that starts on one point
+    std::vector<vec2> home;
+    spawn_points(map, gen.start, 5, &home);
     Unit unit = {0};
-    unit.pos = {15 * TILE_SIZE, 15 * TILE_SIZE};
     unit.tilesetpos = { 0 * TILE_SIZE, 0 * TILE_SIZE, TILE_SIZE, TILE_SIZE};
     unit.hp = 10;
     unit.mana = 10;
     unit.type = UNIT_IMP;
-    dungeonMap.units.push_back(unit);
+    spawn_unit(&map->units, home[0], &unit);
     unit.type = UNIT_DEMON;
     unit.tilesetpos = { 1 * TILE_SIZE, 0 * TILE_SIZE, TILE_SIZE, TILE_SIZE};
-    dungeonMap.units.push_back(unit);
+    spawn_unit(&map->units, home[1], &unit);
     unit.type = UNIT_ORC;
-    unit.pos = {15 * TILE_SIZE, 16 * TILE_SIZE};
     unit.tilesetpos = { 2 * TILE_SIZE, 0 * TILE_SIZE, TILE_SIZE, TILE_SIZE};
-    dungeonMap.units.push_back(unit);
+    spawn_unit(&map->units, home[2], &unit);
     unit.type = UNIT_SKELETON;
-    unit.pos = {15 * TILE_SIZE, 17 * TILE_SIZE};
     unit.tilesetpos = { 3 * TILE_SIZE, 0 * TILE_SIZE, TILE_SIZE, TILE_SIZE};
-    dungeonMap.units.push_back(unit);
+    spawn_unit(&map->units, home[3], &unit);
     unit.type = UNIT_DRAGON;
-    unit.pos = {15 * TILE_SIZE, 18 * TILE_SIZE};
     unit.tilesetpos = { 4 * TILE_SIZE, 0 * TILE_SIZE, TILE_SIZE, TILE_SIZE};
-    dungeonMap.units.push_back(unit);
+    spawn_unit(&map->units, home[4], &unit);
+}
+
+//runs the dungeon with no window, for soak tests: --headless ticks [speed].
+//speed is a multiple of real time, 0 or none runs flat out. searches run in
+//lockstep, so with --seed the run repeats exactly.
+static inline
+int run_headless(u32 ticks, f32 speed, u32 seed) {
+    DungeonMap dungeonMap = {0};
+    setup_dungeon(&dungeonMap, seed, true);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(u32 tick = 0; tick < ticks; ++tick) {
+        simulate_tick(&dungeonMap, SIM_DT);
+        if(speed > 0)
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<f64>((tick + 1) * SIM_DT / speed)));
+    }
+    f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%u ticks in %.2f s, %.1fx real time, %u units, %u tiles queued for mining\n",
+           ticks, seconds, ticks * SIM_DT / seconds, unit_count(&dungeonMap.units), (u32)dungeonMap.minequeue.size());
+    stop_path_service(&dungeonMap.pathservice);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    //--seed on the command line beats SEED in the config, and neither picks one at random
+    u32 seed;
+    char value[32];
+    if(read_config_value("data/config.txt", "SEED", value, sizeof(value)) && strcmp(value, "RANDOM") != 0)
+        seed = strtoul(value, NULL, 10);
+    else
+        seed = random_seed();
+
+    i32 headlessticks = -1;
+    f32 speed = 0;
+    for(i32 i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = strtoul(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            headlessticks = atoi(argv[++i]);
+            if(i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0)
+                speed = atof(argv[++i]);
+        }
+    }
+    if(headlessticks >= 0)
+        return run_headless(headlessticks, speed, seed);
+
+    printf("\n/////////////////////////////////\nPROGRAM STARTING\n/////////////////////////////////\n\n");
+    init_window(640, 360, "Monster Manager", false, true, true);
+    init_audio();
+    set_fps_cap(60);
+    set_master_volume(100);
+    set_vsync(true);
+    set_mouse_state(MOUSE_HIDDEN);
+
+    //every texture goes in one atlas. with layers it is a single texture array the
+    //batch binds once a frame, a 3.0 context gets the vertex batch and a plain atlas.
+    bool layered = has_gl_version(3, 3);
+    RenderBatch spritebatch = layered ? create_layered_batch() : create_batch();
+    RenderBatch * batch = &spritebatch;
+    Shader basic = layered ? load_layered_shader_2D() : load_default_shader_2D();
+    TextureAtlas atlas = layered ? create_layered_atlas(1024, 1024, 4, GL_NEAREST) : create_atlas(2048, 2048, GL_NEAREST);
+    MainState state = GOTO_TITLE;
+
+    DungeonMap dungeonMap = {0};
+    setup_dungeon(&dungeonMap, seed, false);
+
+    Texture cursor = load_texture(&atlas, "data/art/cursor.png");
 
     start_shader(basic);
     upload_mat4(basic, "projection", orthographic_projection(0, 0, get_window_width(), get_window_height(), -1, 1));
     stop_shader();
 
-    DungeonScene dungeonScene;
+    DungeonScene dungeonScene = {0};
+    f64 previoustime = 0;
+    f64 unsimulated = 0; //seconds the sim is behind the clock
     TitleScene titlescene; 
 
     while(window_open()) {
@@ -180,22 +271,43 @@ int main() {
         begin2D(batch, basic);
             
             if(state == GOTO_TITLE) {
-                titlescene = load_title_scene();
+                titlescene = load_title_scene(&atlas);
                 state = MAIN_TITLE;
             }
             if(state == MAIN_TITLE) {
                 title_screen(batch, &titlescene, &state, mouse);
             }
             if(state == GOTO_DUNGEON) {
-                dungeonScene = load_dungeon_scene();
+                dungeonScene = load_dungeon_scene(&atlas);
                 dispose_title_scene(&titlescene);
                 state = MAIN_DUNGEON;
+                previoustime = get_elapsed_time();
+                unsimulated = 0;
             }
             if(state == MAIN_DUNGEON) {
-                dungeon(batch, &dungeonMap, &dungeonScene, mouse);
+                dungeon_input(&dungeonMap, mouse);
+
+                //the sim steps in fixed ticks whatever the frame rate is
+                f64 now = get_elapsed_time();
+                unsimulated += now - previoustime;
+                previoustime = now;
+                i32 ticks = 0;
+                while(unsimulated >= SIM_DT && ticks < MAX_TICKS_PER_FRAME) {
+                    simulate_tick(&dungeonMap, SIM_DT);
+                    unsimulated -= SIM_DT;
+                    ticks++;
+                }
+                if(ticks == MAX_TICKS_PER_FRAME)
+                    unsimulated = 0;
+
+                draw_dungeon(batch, &dungeonMap, &dungeonScene);
             }
-            if(state == MAIN_EXIT) 
+            if(state == MAIN_EXIT) {
+                stop_path_service(&dungeonMap.pathservice);
+                dispose_dungeon_scene(&dungeonScene);
+                dispose_map(&dungeonMap.map);
                 exit(0);
+            }
 
             draw_texture(batch, cursor, mouse.x, mouse.y);
             
@@ -203,7 +315,11 @@ int main() {
         end_drawing();
     }
 
+    stop_path_service(&dungeonMap.pathservice);
+    dispose_dungeon_scene(&dungeonScene);
+    dispose_map(&dungeonMap.map);
     dispose_batch(batch);
+    dispose_atlas(&atlas);
     dispose_window();
 
     return 0;
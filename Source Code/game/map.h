@@ -2,10 +2,8 @@
 #define MAP_H
 
 #include <vector>
-#include <memory>
 #include <algorithm>
-#include "bahamut.h"
-#include "utils.h"
+#include "core.h"
 
 //
 //   CONSTANTS
@@ -15,7 +13,6 @@
 
 const i32 TILE_SIZE = 16;
 const i32 TILESET_WIDTH = 13; //measured in 16x16 blocked, aka tiles
-const i32 SCROLL_SPEED = 4;
 
 const f32 MAX_SPEED = 0.8;
 const f32 MAX_FORCE = 1.0;
@@ -50,13 +47,12 @@ enum UnitState {
     UNIT_MINING,
     UNIT_WALKING,
     UNIT_BUSY,
-    UNIT_RAIDING
+    UNIT_RAIDING,
+    UNIT_WAITING //for a path from the path service
 };
 
+//what a unit is, apart from where it is and where it is going. see unitstore.h
 struct Unit {
-    vec2 pos;
-    vec2 velocity;
-    vec2 force;
     Rect tilesetpos;
 
     i32 expToNext;
@@ -68,31 +64,84 @@ struct Unit {
 
     UnitType type;
     UnitState state;
-    std::vector<vec2> path;
+    u32 ticket; //path request being waited on
 };
-typedef std::vector<Unit> UnitList;
 
-struct Map {
-    i32* grid;
-    u16 width;
-    u16 height;
-    i32 x;
-    i32 y;
+struct UnitHashEntry {
+    vec2 pos;
+    u32 cell; //packed tile coordinates, to skip other cells sharing the bucket
+    u32 unit; //index into the positions the hash was built from
+};
+
+//units bucketed by the tile they stand on, rebuilt every tick with a
+//counting sort. bucket b holds entries[start[b]] up to entries[start[b + 1]].
+struct UnitHash {
+    std::vector<u32> start;
+    std::vector<UnitHashEntry> entries;
+    std::vector<u32> bucket; //bucket of each unit while building
+    u32 mask;
 };
 
-struct Node;
-typedef std::shared_ptr<Node> NodePtr;
+const u32 NO_PARENT = 0xFFFFFFFF;
+
+//search nodes live in one contiguous arena owned by a PathGrid and point at
+//their parent by index, so a warm search does not touch the heap.
 struct Node {
-    Node(i32 x, i32 y, NodePtr parent, i32 fcost) {
-        this->x = x;
-        this->y = y;
-        this->parent = parent;
-        this->fcost = fcost;
-    }
     i32 x;
     i32 y;
-    NodePtr parent;
+    i32 gcost;
     i32 fcost;
+    u32 parent;
+    i32 heapindex; //position in the open heap, -1 once the node is closed
+};
+
+//scratch memory for the pathfinders, one entry per map cell. a cell's node
+//index is only valid when its stamp matches the current generation, so the
+//arrays never have to be cleared between searches.
+struct PathGrid {
+    u32* stamp;
+    u32* node;
+    Node* nodes;
+    u32 nodecount;
+    u32 nodecapacity;
+    u32* heap;
+    u32 heapcount;
+    u32 generation;
+    u32 size;
+    u32 budget; //nodes a search may close before giving up, 0 for no limit
+};
+
+enum TerrainType {
+    TERRAIN_FLOOR,
+    TERRAIN_WALL,
+};
+
+//tiles are stored in CHUNK_SIZE x CHUNK_SIZE chunks, row by row inside each
+//chunk, so the tiles above and below one are usually in the same few cache
+//lines. a cell is a tile's position in that storage, see tile_index.
+const i32 CHUNK_SHIFT = 4;
+const i32 CHUNK_SIZE = 1 << CHUNK_SHIFT;
+const i32 CHUNK_AREA = CHUNK_SIZE * CHUNK_SIZE;
+
+//grid holds the graphic of each tile. what a tile is lives in terrain, with
+//passability packed one bit per cell beside it so searches stay in cache.
+//change tiles through set_cell so the three stay in step. the edge chunks
+//are padded out to full size with walls.
+struct Map {
+    i32* grid;
+    u64* blocked; //bit set if the cell can't be walked through
+    u8* terrain; //TerrainType per cell
+    i32 width;
+    i32 height;
+    i32 chunkswide;
+    i32 chunkshigh;
+    i32 x;
+    i32 y;
+    PathGrid* paths;
+    u32 version; //bumped whenever grid changes
+    u32* chunkversions; //bumped per chunk whenever a tile in it changes, for caches built from the chunk
+    u8* orientbuffer; //scratch rows for orient_tiles_region, see get_orient_buffer
+    u32 orientcapacity;
 };
 
 //
@@ -106,6 +155,96 @@ bool blocked_tile(i32 id) {
     return false;
 }
 
+//the cell of tile (x, y), which has to be on the map
+static inline
+u32 tile_index(Map* map, i32 x, i32 y) {
+    u32 chunk = (x >> CHUNK_SHIFT) + (y >> CHUNK_SHIFT) * map->chunkswide;
+    return (chunk << (CHUNK_SHIFT * 2)) | ((y & (CHUNK_SIZE - 1)) << CHUNK_SHIFT) | (x & (CHUNK_SIZE - 1));
+}
+
+static inline
+void tile_position(Map* map, u32 cell, i32* x, i32* y) {
+    u32 chunk = cell >> (CHUNK_SHIFT * 2);
+    *x = (chunk % map->chunkswide) * CHUNK_SIZE + (cell & (CHUNK_SIZE - 1));
+    *y = (chunk / map->chunkswide) * CHUNK_SIZE + ((cell >> CHUNK_SHIFT) & (CHUNK_SIZE - 1));
+}
+
+//number of cells including the padding, the size of anything indexed by cell
+static inline
+u32 map_cells(Map* map) {
+    return map->chunkswide * map->chunkshigh * CHUNK_AREA;
+}
+
+static inline
+bool cell_blocked(Map* map, u32 cell) {
+    return (map->blocked[cell >> 6] >> (cell & 63)) & 1;
+}
+
+static inline
+void set_cell(Map* map, u32 cell, i32 id) {
+    u64 bit = (u64)1 << (cell & 63);
+    map->grid[cell] = id;
+    map->chunkversions[cell >> (CHUNK_SHIFT * 2)]++;
+    if(blocked_tile(id)) {
+        map->terrain[cell] = TERRAIN_WALL;
+        map->blocked[cell >> 6] |= bit;
+    } else {
+        map->terrain[cell] = TERRAIN_FLOOR;
+        map->blocked[cell >> 6] &= ~bit;
+    }
+}
+
+static inline
+i32 get_tile(Map* map, i32 x, i32 y) {
+    return map->grid[tile_index(map, x, y)];
+}
+
+static inline
+bool tile_blocked(Map* map, i32 x, i32 y) {
+    return cell_blocked(map, tile_index(map, x, y));
+}
+
+static inline
+void set_tile(Map* map, i32 x, i32 y, i32 id) {
+    set_cell(map, tile_index(map, x, y), id);
+}
+
+//a width x height map with every tile set to id
+static inline
+Map create_map(i32 width, i32 height, i32 id) {
+    Map map = {0};
+    map.width = width;
+    map.height = height;
+    map.chunkswide = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    map.chunkshigh = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    u32 size = map_cells(&map);
+    map.grid = (i32*)calloc(size, sizeof(i32));
+    map.blocked = (u64*)malloc(sizeof(u64) * (size / 64));
+    map.terrain = (u8*)malloc(size);
+    map.chunkversions = (u32*)calloc(map.chunkswide * map.chunkshigh, sizeof(u32));
+    memset(map.blocked, 0xFF, sizeof(u64) * (size / 64));
+    memset(map.terrain, TERRAIN_WALL, size);
+
+    //a chunk row is 16 cells in a row of storage and a quarter of a blocked word
+    bool wall = blocked_tile(id);
+    for(i32 y = 0; y < height; ++y) {
+        for(i32 x = 0; x < width; x += CHUNK_SIZE) {
+            u32 cell = tile_index(&map, x, y);
+            i32 run = std::min(CHUNK_SIZE, width - x);
+            u64 bits = (((u64)1 << run) - 1) << (cell & 63);
+            for(i32 i = 0; i < run; ++i)
+                map.grid[cell + i] = id;
+            memset(map.terrain + cell, wall ? TERRAIN_WALL : TERRAIN_FLOOR, run);
+            if(wall)
+                map.blocked[cell >> 6] |= bits;
+            else
+                map.blocked[cell >> 6] &= ~bits;
+        }
+    }
+    return map;
+}
+
 static inline
 void check_blocked_neighbors(Map* map, i32 x, i32 y, bool* up, bool* down, bool* left, bool* right) {
     *up = true;
@@ -114,13 +253,13 @@ void check_blocked_neighbors(Map* map, i32 x, i32 y, bool* up, bool* down, bool*
     *right = true;
 
     if(y-1 >= 0) 
-        *up = blocked_tile(map->grid[x + (y-1) * map->width]);
-    if(y + 1 <= map->height)
-        *down = blocked_tile(map->grid[x + (y+1) * map->width]);
+        *up = tile_blocked(map, x, y-1);
+    if(y + 1 < map->height)
+        *down = tile_blocked(map, x, y+1);
     if(x - 1 >= 0)
-        *left = blocked_tile(map->grid[(x-1) + y * map->width]);
-    if(x + 1 <= map->width)
-        *right = blocked_tile(map->grid[(x+1) + y * map->width]);
+        *left = tile_blocked(map, x-1, y);
+    if(x + 1 < map->width)
+        *right = tile_blocked(map, x+1, y);
 }
 
 static inline
@@ -149,112 +288,208 @@ bool all_sides_blocked(Map* map, i32 x, i32 y) {
     return false;
 }
 
-static inline
-void orient_tiles(Map* map) {
-    for(i32 x = 0; x < map->width; ++x) {
-        for(i32 y = 0; y < map->height; ++y) {
-            u32 index = x + y * map->width;
-            i32 id = map->grid[index];
-
-            bool upblocked, downblocked, leftblocked, rightblocked;
-            check_blocked_neighbors(map, x, y, &upblocked, &downblocked, &leftblocked, &rightblocked);
-
-            if(blocked_tile(id)) {
-                if(downblocked && rightblocked)
-                    map->grid[index] = 0;
-
-                if(downblocked && leftblocked)
-                    map->grid[index] = 2;
-
-                if(upblocked && rightblocked)
-                    map->grid[index] = 0 + 2 * TILESET_WIDTH;
-
-                if(upblocked && leftblocked)
-                    map->grid[index] = 2 + 2 * TILESET_WIDTH;
-
-                if((!leftblocked || !rightblocked) && upblocked && downblocked) 
-                    map->grid[index] = 0 + 1 * TILESET_WIDTH;
-
-                if((!downblocked || !upblocked) && leftblocked && rightblocked)
-                    map->grid[index] = 1 + 0 * TILESET_WIDTH;
-
-                if(!upblocked && !downblocked && !rightblocked && !leftblocked)
-                    map->grid[index] = 1 + 1 * TILESET_WIDTH;
-
-                if(upblocked && downblocked && rightblocked && leftblocked) {
-                    map->grid[index] = 1 + 2 * TILESET_WIDTH;
+//a tile's graphic is picked from which of its 8 neighbors are blocked (off the
+//map counts as blocked), packed into one byte and looked up in a table.
 
-                    if(x - 1 >= 0 && y - 1 >= 0)
-                        if(!blocked_tile(map->grid[(x-1) + (y-1) * map->width]))
-                            map->grid[index] = 2 + 2 * TILESET_WIDTH;
+const u8 BLOCKED_UP = 1 << 0;
+const u8 BLOCKED_DOWN = 1 << 1;
+const u8 BLOCKED_LEFT = 1 << 2;
+const u8 BLOCKED_RIGHT = 1 << 3;
+const u8 BLOCKED_UPLEFT = 1 << 4;
+const u8 BLOCKED_UPRIGHT = 1 << 5;
+const u8 BLOCKED_DOWNLEFT = 1 << 6;
+const u8 BLOCKED_DOWNRIGHT = 1 << 7;
 
-                    if(x + 1 <= map->width && y - 1 >= 0)
-                        if(!blocked_tile(map->grid[(x+1) + (y-1) * map->width]))
-                            map->grid[index] = 0 + 2 * TILESET_WIDTH;
+const i32 KEEP_TILE = -1; //no rule matched, the tile keeps the id it has
 
-                    if(x - 1 >= 0 && y + 1 <= map->height)
-                        if(!blocked_tile(map->grid[(x-1) + (y+1) * map->width]))
-                            map->grid[index] = 2 + 0 * TILESET_WIDTH;
-
-                    if(x + 1 <= map->width && y + 1 <= map->height)
-                        if(!blocked_tile(map->grid[(x+1) + (y+1) * map->width]))
-                            map->grid[index] = 0;
-                }
-
-            } else {
-                if(leftblocked)
-                    map->grid[index] = 6 + 1 * TILESET_WIDTH;
-
-                if(upblocked)
-                    map->grid[index] = 7 + 0 * TILESET_WIDTH;
-
-                if(rightblocked)
-                    map->grid[index] = 8 + 1 * TILESET_WIDTH;
-
-                if(downblocked)
-                    map->grid[index] = 7 + 2 * TILESET_WIDTH;
-
-                if(upblocked && leftblocked)
-                    map->grid[index] = 6 + 0 * TILESET_WIDTH;
-
-                if(upblocked && rightblocked)
-                    map->grid[index] = 8 + 0 * TILESET_WIDTH;
-
-                if(downblocked && leftblocked)
-                    map->grid[index] = 6 + 2 * TILESET_WIDTH;
-
-                if(downblocked && rightblocked)
-                    map->grid[index] = 8 + 2 * TILESET_WIDTH;
-
-                if(upblocked && leftblocked && rightblocked)
-                    map->grid[index] = 9 + 0 * TILESET_WIDTH;
-
-                if(leftblocked && rightblocked)
-                    map->grid[index] = 9 + 1 * TILESET_WIDTH;
+struct AutotileTable {
+    i32 wall[256];
+    i32 floor[256];
+};
 
-                if(downblocked && leftblocked && rightblocked)
-                    map->grid[index] = 9 + 2 * TILESET_WIDTH;
+//the rules, in the order they were always applied. later rules win.
+constexpr AutotileTable make_autotile_table() {
+    AutotileTable table = {};
+    for(i32 mask = 0; mask < 256; ++mask) {
+        bool upblocked = mask & BLOCKED_UP;
+        bool downblocked = mask & BLOCKED_DOWN;
+        bool leftblocked = mask & BLOCKED_LEFT;
+        bool rightblocked = mask & BLOCKED_RIGHT;
+
+        i32 id = KEEP_TILE;
+        if(downblocked && rightblocked)
+            id = 0;
+        if(downblocked && leftblocked)
+            id = 2;
+        if(upblocked && rightblocked)
+            id = 0 + 2 * TILESET_WIDTH;
+        if(upblocked && leftblocked)
+            id = 2 + 2 * TILESET_WIDTH;
+        if((!leftblocked || !rightblocked) && upblocked && downblocked)
+            id = 0 + 1 * TILESET_WIDTH;
+        if((!downblocked || !upblocked) && leftblocked && rightblocked)
+            id = 1 + 0 * TILESET_WIDTH;
+        if(!upblocked && !downblocked && !rightblocked && !leftblocked)
+            id = 1 + 1 * TILESET_WIDTH;
+        if(upblocked && downblocked && rightblocked && leftblocked) {
+            id = 1 + 2 * TILESET_WIDTH;
+            if(!(mask & BLOCKED_UPLEFT))
+                id = 2 + 2 * TILESET_WIDTH;
+            if(!(mask & BLOCKED_UPRIGHT))
+                id = 0 + 2 * TILESET_WIDTH;
+            if(!(mask & BLOCKED_DOWNLEFT))
+                id = 2 + 0 * TILESET_WIDTH;
+            if(!(mask & BLOCKED_DOWNRIGHT))
+                id = 0;
+        }
+        table.wall[mask] = id;
+
+        id = KEEP_TILE;
+        if(leftblocked)
+            id = 6 + 1 * TILESET_WIDTH;
+        if(upblocked)
+            id = 7 + 0 * TILESET_WIDTH;
+        if(rightblocked)
+            id = 8 + 1 * TILESET_WIDTH;
+        if(downblocked)
+            id = 7 + 2 * TILESET_WIDTH;
+        if(upblocked && leftblocked)
+            id = 6 + 0 * TILESET_WIDTH;
+        if(upblocked && rightblocked)
+            id = 8 + 0 * TILESET_WIDTH;
+        if(downblocked && leftblocked)
+            id = 6 + 2 * TILESET_WIDTH;
+        if(downblocked && rightblocked)
+            id = 8 + 2 * TILESET_WIDTH;
+        if(upblocked && leftblocked && rightblocked)
+            id = 9 + 0 * TILESET_WIDTH;
+        if(leftblocked && rightblocked)
+            id = 9 + 1 * TILESET_WIDTH;
+        if(downblocked && leftblocked && rightblocked)
+            id = 9 + 2 * TILESET_WIDTH;
+        if(upblocked && leftblocked && downblocked)
+            id = 10 + 1 * TILESET_WIDTH;
+        if(upblocked && downblocked)
+            id = 11 + 1 * TILESET_WIDTH;
+        if(upblocked && rightblocked && downblocked)
+            id = 12 + 1 * TILESET_WIDTH;
+        if(upblocked && downblocked && rightblocked && leftblocked)
+            id = 11 + 0 * TILESET_WIDTH;
+        if(!upblocked && !downblocked && !rightblocked && !leftblocked)
+            id = 7 + 1 * TILESET_WIDTH;
+        table.floor[mask] = id;
+    }
+    return table;
+}
 
-                if(upblocked && leftblocked && downblocked)
-                    map->grid[index] = 10 + 1 * TILESET_WIDTH;
+constexpr AutotileTable AUTOTILE = make_autotile_table();
 
-                if(upblocked && downblocked)
-                    map->grid[index] = 11 + 1 * TILESET_WIDTH;
+//blocked flags for columns x0 - 1 through x1 + 1 of row y. a chunk row is
+//CHUNK_SIZE neighboring bits of one word, so it comes out in one load.
+static inline
+void blocked_row(Map* map, i32 y, i32 x0, i32 x1, u8* out) {
+    if(y < 0 || y >= map->height) {
+        memset(out, 1, x1 - x0 + 3);
+        return;
+    }
+    for(i32 x = x0 - 1; x <= x1 + 1;) {
+        if(x < 0 || x >= map->width) {
+            *out++ = 1;
+            x++;
+            continue;
+        }
+        //the padding past the last column reads as blocked like the map edge
+        u32 cell = tile_index(map, x, y);
+        u64 bits = map->blocked[cell >> 6] >> (cell & 63);
+        i32 run = std::min(x1 + 2 - x, CHUNK_SIZE - (x & (CHUNK_SIZE - 1)));
+        for(i32 i = 0; i < run; ++i)
+            *out++ = (bits >> i) & 1;
+        x += run;
+    }
+}
 
-                if(upblocked && rightblocked && downblocked)
-                    map->grid[index] = 12 + 1 * TILESET_WIDTH;
+//bytes of scratch orient_tiles_region needs for a region count tiles wide
+static inline
+u32 orient_buffer_size(i32 count) {
+    return (count + 2) * 3 + count;
+}
 
-                if(upblocked && downblocked && rightblocked && leftblocked)
-                    map->grid[index] = 13 + 0 * TILESET_WIDTH;
+//the map keeps its scratch between calls, so redoing the few tiles around a
+//dig every tick never allocates once it has grown to fit
+static inline
+u8* get_orient_buffer(Map* map, i32 count) {
+    u32 size = orient_buffer_size(count);
+    if(map->orientcapacity < size) {
+        free(map->orientbuffer);
+        map->orientbuffer = (u8*)malloc(size);
+        map->orientcapacity = size;
+    }
+    return map->orientbuffer;
+}
 
-                if(!upblocked && !downblocked && !rightblocked && !leftblocked)
-                    map->grid[index] = 7 + 1 * TILESET_WIDTH;
+//redoes the tiles in the inclusive rectangle (x0, y0) to (x1, y1). a new
+//graphic never changes whether a tile is blocked, so the order does not matter,
+//it can go a row at a time, and it writes grid directly instead of set_cell.
+//buffer needs orient_buffer_size(x1 - x0 + 1) bytes, callers running side by
+//side each bring their own.
+static inline
+void orient_tiles_region(Map* map, i32 x0, i32 y0, i32 x1, i32 y1, u8* buffer) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, map->width - 1);
+    y1 = std::min(y1, map->height - 1);
+    if(x0 > x1 || y0 > y1)
+        return;
+
+    i32 count = x1 - x0 + 1;
+    i32 span = count + 2;
+    u8* above = buffer;
+    u8* row = buffer + span;
+    u8* below = buffer + span * 2;
+    u8* masks = buffer + span * 3;
+
+    blocked_row(map, y0 - 1, x0, x1, above);
+    blocked_row(map, y0, x0, x1, row);
+    for(i32 y = y0; y <= y1; ++y) {
+        blocked_row(map, y + 1, x0, x1, below);
+
+        //straight-line byte math, so the compiler can do the row in vectors
+        for(i32 i = 0; i < count; ++i) {
+            masks[i] = (above[i + 1] * BLOCKED_UP)   | (below[i + 1] * BLOCKED_DOWN) |
+                       (row[i] * BLOCKED_LEFT)       | (row[i + 2] * BLOCKED_RIGHT) |
+                       (above[i] * BLOCKED_UPLEFT)   | (above[i + 2] * BLOCKED_UPRIGHT) |
+                       (below[i] * BLOCKED_DOWNLEFT) | (below[i + 2] * BLOCKED_DOWNRIGHT);
+        }
 
+        //a row of the region is contiguous only as far as the end of a chunk
+        for(i32 i = 0; i < count;) {
+            u32 cell = tile_index(map, x0 + i, y);
+            i32* tiles = map->grid + cell;
+            i32 run = std::min(count - i, CHUNK_SIZE - ((x0 + i) & (CHUNK_SIZE - 1)));
+            map->chunkversions[cell >> (CHUNK_SHIFT * 2)]++;
+            for(i32 j = 0; j < run; ++j, ++i) {
+                i32 id = row[i + 1] ? AUTOTILE.wall[masks[i]] : AUTOTILE.floor[masks[i]];
+                tiles[j] = id == KEEP_TILE ? tiles[j] : id;
             }
         }
+
+        u8* temp = above;
+        above = row;
+        row = below;
+        below = temp;
     }
 }
 
+static inline
+void orient_tiles_region(Map* map, i32 x0, i32 y0, i32 x1, i32 y1) {
+    orient_tiles_region(map, x0, y0, x1, y1, get_orient_buffer(map, x1 - x0 + 1));
+}
+
+static inline
+void orient_tiles(Map* map) {
+    orient_tiles_region(map, 0, 0, map->width - 1, map->height - 1);
+}
+
 static inline
 vec2 get_closest_mineable(std::vector<vec2>& minequeue, vec2 origin, i32* index) {
     vec2 result = {0};
@@ -272,15 +507,6 @@ vec2 get_closest_mineable(std::vector<vec2>& minequeue, vec2 origin, i32* index)
     return result;
 }
 
-static inline
-void truncate(vec2* v, f32 max) {
-    f32 i = 0;
-    i = max / length(*v);
-    i = i < 1.0 ? i : 1.0;
-    v->x *= i;
-    v->y *= i;
-}
-
 static inline
 void clamp(i32* in, i32 min, i32 max) {
     if(*in > max) *in = max;
@@ -293,49 +519,155 @@ void clamp(f32* in, f32 min, f32 max) {
     if(*in < min) *in = min;
 }
 
+//
+//   UNIT HASH
+//
+
+static inline
+i32 unit_hash_coord(f32 v) {
+    return (i32)floorf(v / TILE_SIZE);
+}
+
+static inline
+u32 unit_hash_cell(i32 cx, i32 cy) {
+    return (u32)(cx + 32768) | ((u32)(cy + 32768) << 16);
+}
+
+//cells next to each other in a row land in neighboring buckets, so a row of
+//cells is one scan over entries
+static inline
+u32 unit_hash_bucket(UnitHash* hash, i32 cx, i32 cy) {
+    return ((u32)cx + (u32)cy * 0x9E3779B1) & hash->mask;
+}
+
+//entries that may be in cells x0 through x1 of row y, as ranges first[i] up
+//to last[i]. there are two when the buckets wrap around the end of the table.
+static inline
+u32 unit_hash_row(UnitHash* hash, i32 x0, i32 x1, i32 y, u32* first, u32* last) {
+    u32 buckets = hash->mask + 1;
+    u32 count = x1 - x0 + 1;
+    if(count >= buckets) {
+        first[0] = 0;
+        last[0] = hash->entries.size();
+        return 1;
+    }
+
+    u32 b = unit_hash_bucket(hash, x0, y);
+    first[0] = hash->start[b];
+    if(b + count <= buckets) {
+        last[0] = hash->start[b + count];
+        return 1;
+    }
+    last[0] = hash->start[buckets];
+    first[1] = hash->start[0];
+    last[1] = hash->start[b + count - buckets];
+    return 2;
+}
+
+static inline
+void build_unit_hash(UnitHash* hash, f32* x, f32* y, u32 count) {
+    u32 buckets = 64;
+    while(buckets < count * 2)
+        buckets <<= 1;
+    hash->mask = buckets - 1;
+    hash->start.assign(buckets + 1, 0);
+    hash->entries.resize(count);
+    hash->bucket.resize(count);
+
+    for(u32 i = 0; i < count; ++i) {
+        u32 b = unit_hash_bucket(hash, unit_hash_coord(x[i]), unit_hash_coord(y[i]));
+        hash->bucket[i] = b;
+        hash->start[b]++;
+    }
+    for(u32 b = 1; b <= buckets; ++b)
+        hash->start[b] += hash->start[b - 1];
+    //start[b] is the end of bucket b here, filling backwards leaves it at the front
+    for(u32 i = count; i-- > 0;) {
+        UnitHashEntry* entry = &hash->entries[--hash->start[hash->bucket[i]]];
+        entry->pos = V2(x[i], y[i]);
+        entry->cell = unit_hash_cell(unit_hash_coord(x[i]), unit_hash_coord(y[i]));
+        entry->unit = i;
+    }
+}
+
+//indices of every unit within radius of pos, pos's own unit included
+static inline
+void query_unit_hash(UnitHash* hash, vec2 pos, f32 radius, std::vector<u32>* out) {
+    out->clear();
+    i32 x0 = unit_hash_coord(pos.x - radius);
+    i32 x1 = unit_hash_coord(pos.x + radius);
+    i32 y0 = unit_hash_coord(pos.y - radius);
+    i32 y1 = unit_hash_coord(pos.y + radius);
+
+    u32 first[2];
+    u32 last[2];
+    for(i32 y = y0; y <= y1; ++y) {
+        u32 lo = unit_hash_cell(x0, y);
+        u32 hi = unit_hash_cell(x1, y);
+        u32 ranges = unit_hash_row(hash, x0, x1, y, first, last);
+        for(u32 r = 0; r < ranges; ++r) {
+            for(u32 i = first[r]; i < last[r]; ++i) {
+                UnitHashEntry* entry = &hash->entries[i];
+                vec2 d = entry->pos - pos;
+                if(entry->cell - lo <= hi - lo && d.x * d.x + d.y * d.y < radius * radius)
+                    out->push_back(entry->unit);
+            }
+        }
+    }
+}
+
 //
 //   PATH STEERING
 //
 
 static inline
-vec2 calculate_seek(vec2 dest, Unit* unit) {
-    vec2 desired = MAX_SPEED * normalize(dest - unit->pos);
-    return (desired*2) - unit->velocity;
+vec2 calculate_seek(vec2 dest, vec2 pos, vec2 velocity) {
+    vec2 desired = MAX_SPEED * normalize(dest - pos);
+    return (desired*2) - velocity;
 }
 
 static inline
-vec2 calculate_seperation(Map* map, UnitList* list, Unit* unit) {
+vec2 calculate_seperation(Map* map, UnitHash* units, vec2 pos) {
     vec2 total = {0};
 
-    // for(u32 i = 0; i < list->size(); ++i) {
-    //     Unit* a = &(*list)[i];
-    //     if(a != unit) {
-    //         f32 dist = getDistanceE(unit->pos.x, unit->pos.y, a->pos.x, a->pos.y);
-    //         if(dist < MIN_SEPERATION && dist >= 0) {
-    //             vec2 push = unit->pos - a->pos;
-    //             total = total + (push/14.0f);
-    //         }
-    //     }
-    // }
-
-    i32 x0 = (unit->pos.x / TILE_SIZE) - 1;
-    i32 x1 = (unit->pos.x / TILE_SIZE) + 1;
-    i32 y0 = (unit->pos.y / TILE_SIZE) - 1;
-    i32 y1 = (unit->pos.y / TILE_SIZE) + 1;
+    //the unit itself is in the hash too, but pushes with zero
+    i32 cx0 = unit_hash_coord(pos.x - MIN_SEPERATION);
+    i32 cx1 = unit_hash_coord(pos.x + MIN_SEPERATION);
+    i32 cy0 = unit_hash_coord(pos.y - MIN_SEPERATION);
+    i32 cy1 = unit_hash_coord(pos.y + MIN_SEPERATION);
+
+    u32 first[2];
+    u32 last[2];
+    for(i32 cy = cy0; cy <= cy1; ++cy) {
+        u32 lo = unit_hash_cell(cx0, cy);
+        u32 hi = unit_hash_cell(cx1, cy);
+        u32 ranges = unit_hash_row(units, cx0, cx1, cy, first, last);
+        for(u32 r = 0; r < ranges; ++r) {
+            for(u32 i = first[r]; i < last[r]; ++i) {
+                UnitHashEntry* a = &units->entries[i];
+                vec2 push = pos - a->pos;
+                if(a->cell - lo <= hi - lo && push.x * push.x + push.y * push.y < MIN_SEPERATION * MIN_SEPERATION)
+                    total = total + (push/14.0f);
+            }
+        }
+    }
+
+    i32 x0 = (pos.x / TILE_SIZE) - 1;
+    i32 x1 = (pos.x / TILE_SIZE) + 1;
+    i32 y0 = (pos.y / TILE_SIZE) - 1;
+    i32 y1 = (pos.y / TILE_SIZE) + 1;
 
     clamp(&x0, 0, map->width);
     clamp(&x1, 0, map->width);
     clamp(&y0, 0, map->height);
     clamp(&y1, 0, map->height);
 
-    for(u32 x = x0; x < x1; ++x) {
-        for(u32 y = y0; y < y1; ++y) {
-            u32 index = x + y * map->width;
-
-            if(blocked_tile(map->grid[index])) {
-                f32 dist = getDistanceE(unit->pos.x, unit->pos.y, x * TILE_SIZE, y * TILE_SIZE);
+    for(i32 x = x0; x < x1; ++x) {
+        for(i32 y = y0; y < y1; ++y) {
+            if(tile_blocked(map, x, y)) {
+                f32 dist = getDistanceE(pos.x, pos.y, x * TILE_SIZE, y * TILE_SIZE);
                 if(dist <= TILE_SIZE-2 && dist >= 0) {
-                    vec2 push = unit->pos - V2(x * TILE_SIZE, y * TILE_SIZE);
+                    vec2 push = pos - V2(x * TILE_SIZE, y * TILE_SIZE);
                     total = total + (push/8.5);
                 }
             }
@@ -348,394 +680,559 @@ vec2 calculate_seperation(Map* map, UnitList* list, Unit* unit) {
 //   PATHFINDING
 //
 
+const i32 STRAIGHT_COST = 10;
+const i32 DIAGONAL_COST = 14;
+
+//an unreachable dest has to flood everything start can reach before a search
+//knows, millions of tiles on a big map. past this many nodes searches give up
+//and report no path, the same as if there were none. a 512x512 area.
+const u32 PATH_NODE_BUDGET = 1 << 18;
+
 static inline
-bool compare_ptr_to_node(NodePtr a, NodePtr b) {
-    return (a->fcost >= b->fcost);
+PathGrid* create_path_grid(u32 size) {
+    PathGrid* grid = (PathGrid*)malloc(sizeof(PathGrid));
+    grid->size = size;
+    grid->generation = 0;
+    grid->stamp = (u32*)calloc(size, sizeof(u32));
+    grid->node = (u32*)malloc(sizeof(u32) * size);
+    grid->heap = (u32*)malloc(sizeof(u32) * size);
+    grid->heapcount = 0;
+    grid->nodes = NULL;
+    grid->nodecount = 0;
+    grid->nodecapacity = 0;
+    grid->budget = PATH_NODE_BUDGET;
+    return grid;
 }
 
 static inline
-void process_successor(i32 x, i32 y, i32 fcost, NodePtr parent, std::vector<NodePtr>& open, std::vector<NodePtr>& closed) {
-    if(x < 0 || y < 0) return;
-
-    for(u16 i = 0; i < open.size(); ++i) {
-        i32 nodex = open[i]->x;
-        i32 nodey = open[i]->y;
-        if(nodex == x && nodey == y) {
-            if(open[i]->fcost <= fcost)
-                return;
-            break;
-        }
-    }
-
-    for(u16 i = 0; i < closed.size(); ++i) {
-        i32 nodex = closed[i]->x;
-        i32 nodey = closed[i]->y;
-        if(nodex == x && nodey == y) {
-            if(closed[i]->fcost <= fcost)
-                return;
-            break;
-        }
-    }
-    open.push_back(NodePtr(new Node(x, y, parent, fcost)));
+void dispose_path_grid(PathGrid* grid) {
+    free(grid->stamp);
+    free(grid->node);
+    free(grid->heap);
+    free(grid->nodes);
+    free(grid);
 }
 
 static inline
-std::vector<vec2> reconstruct_path(NodePtr current) {
-    std::vector<vec2> path;
-    while(current->parent != NULL) {
-        path.push_back({(f32)current->x, (f32)current->y});
-        current = current->parent;
+PathGrid* get_path_grid(Map* map) {
+    u32 size = map_cells(map);
+    if(map->paths != NULL && map->paths->size != size) {
+        dispose_path_grid(map->paths);
+        map->paths = NULL;
     }
-    path.push_back({(f32)current->x, (f32)current->y});
-    return path;
+    if(map->paths == NULL)
+        map->paths = create_path_grid(size);
+    return map->paths;
 }
 
+//starts a new search. bumping the generation invalidates every cell at once,
+//the stamps only get wiped when the counter wraps around.
 static inline
-bool jump_search_horizontal(Map* map, NodePtr current, std::vector<vec2>& successors, i32 dx, vec2 dest) {
-    vec2 currpt = {(f32)current->x, (f32)current->y};
-
-    for(;;) {
-        currpt.x+=dx;
-        //if reached destination
-        if(currpt.x == dest.x && currpt.y == dest.y) {
-            successors.push_back(currpt);
-            return false;
-        }
-        //if a wall or edge of map reached, exit
-        u32 index3 = currpt.x + currpt.y * map->width;
-        if(currpt.x < 0 || currpt.x > map->width-1 || blocked_tile(map->grid[index3]))
-            return true;
-
-        //if there are forced neighbors up or down, add successor and exit
-        u32 index = currpt.x + (currpt.y-1) * map->width;
-        u32 index2 = currpt.x + (currpt.y+1) * map->width;
-        if(currpt.y - 1 < 0 || currpt.y + 1 > map->height-1) {
-            successors.push_back(currpt);
-            return false;
-        }
-        if(blocked_tile(map->grid[index]) || blocked_tile(map->grid[index2])) {
-            successors.push_back({currpt.x, currpt.y});
-            return false;
-        }
+void reset_path_grid(PathGrid* grid) {
+    grid->heapcount = 0;
+    grid->nodecount = 0;
+    grid->generation++;
+    if(grid->generation == 0) {
+        memset(grid->stamp, 0, sizeof(u32) * grid->size);
+        grid->generation = 1;
     }
 }
 
+//returns the node index of a cell visited by the current search, or NO_PARENT
 static inline
-bool jump_search_vertical(Map* map, NodePtr current, std::vector<vec2>& successors, i32 dy, vec2 dest) {
-    vec2 currpt = {(f32)current->x, (f32)current->y};
+u32 get_node(PathGrid* grid, i32 cell) {
+    if(grid->stamp[cell] != grid->generation)
+        return NO_PARENT;
+    return grid->node[cell];
+}
 
-    for(;;) {
-        currpt.y+=dy;
-        //if reached destination
-        if(currpt.x == dest.x && currpt.y == dest.y) {
-            successors.push_back(currpt);
-            return false;
-        }
-        //if a wall or edge of map reached, exit
-        u32 index3 = currpt.x + currpt.y * map->width;
-        if(currpt.y < 0 || currpt.y > map->height-1 || blocked_tile(map->grid[index3]))
-            return true;
-
-        //if there are forced neighbors left or right, add successor and exit
-        u32 index = (currpt.x-1) + currpt.y * map->width;
-        u32 index2 = (currpt.x+1) + currpt.y * map->width;
-        if(currpt.x - 1 < 0 || currpt.x + 1 > map->width-1) {
-            successors.push_back(currpt);
-            return false;
-        }
-        if(blocked_tile(map->grid[index]) || blocked_tile(map->grid[index2])) {
-            successors.push_back({currpt.x, currpt.y});
-            return false;
-        }
+//the arena only grows, so after the first few searches this never allocates.
+//any Node* held across this call is invalidated, hold indices instead.
+static inline
+u32 push_node(PathGrid* grid, i32 cell, i32 x, i32 y) {
+    if(grid->nodecount == grid->nodecapacity) {
+        grid->nodecapacity = grid->nodecapacity == 0 ? 256 : grid->nodecapacity * 2;
+        grid->nodes = (Node*)realloc(grid->nodes, sizeof(Node) * grid->nodecapacity);
     }
+    u32 index = grid->nodecount++;
+    grid->stamp[cell] = grid->generation;
+    grid->node[cell] = index;
+
+    Node* node = &grid->nodes[index];
+    node->x = x;
+    node->y = y;
+    node->gcost = 0;
+    node->fcost = 0;
+    node->parent = NO_PARENT;
+    node->heapindex = -1;
+    return index;
 }
 
 static inline
-std::vector<vec2> find_successors(Map* map, NodePtr current, vec2 start, vec2 dest) {
-    std::vector<vec2> successors;
-    //go in all four cardinal directions, if all of them
-    //hit walls, with no forced neighbors, then it is safe to traverse
-    //diagonally.
-    //if there are forced neighbors at any point (traversing diagonally
-    //or cardinally), then add that node to the open list (successors in
-    //this func) and continue with the A* processing.
-
-    bool left_hit_wall = jump_search_horizontal(map, current, successors, -1, dest);
-    bool right_hit_wall = jump_search_horizontal(map, current, successors, 1, dest);
-
-    bool up_hit_wall = jump_search_vertical(map, current, successors, -1, dest);
-    bool down_hit_wall = jump_search_vertical(map, current, successors,1, dest);
+bool heap_less(PathGrid* grid, u32 a, u32 b) {
+    Node* na = &grid->nodes[a];
+    Node* nb = &grid->nodes[b];
+    if(na->fcost != nb->fcost)
+        return na->fcost < nb->fcost;
+    //on ties prefer the node that is further along, it is closer to the goal
+    return na->gcost > nb->gcost;
+}
 
-    if(right_hit_wall && up_hit_wall) {
-        //SAFE to go up and right
-        u32 index = (current->x + 1) + (current->y - 1) * map->width;
-        if(current->x + 1 < map->width - 1 && current->y - 1 > 0 && !blocked_tile(map->grid[index]))
-            successors.push_back({(f32)current->x + 1, (f32)current->y - 1});
+static inline
+void heap_sift_up(PathGrid* grid, u32 pos) {
+    u32 index = grid->heap[pos];
+    while(pos > 0) {
+        u32 up = (pos - 1) / 2;
+        if(!heap_less(grid, index, grid->heap[up]))
+            break;
+        grid->heap[pos] = grid->heap[up];
+        grid->nodes[grid->heap[pos]].heapindex = pos;
+        pos = up;
     }
+    grid->heap[pos] = index;
+    grid->nodes[index].heapindex = pos;
+}
 
-    if(up_hit_wall && left_hit_wall) {
-        //SAFE to go up and left
-        u32 index = (current->x - 1) + (current->y - 1) * map->width;
-        if(current->x - 1 > 0 && current->y - 1 > 0 && !blocked_tile(map->grid[index]))
-            successors.push_back({(f32)current->x - 1, (f32)current->y - 1});
+static inline
+void heap_sift_down(PathGrid* grid, u32 pos) {
+    u32 index = grid->heap[pos];
+    for(;;) {
+        u32 child = pos * 2 + 1;
+        if(child >= grid->heapcount)
+            break;
+        if(child + 1 < grid->heapcount && heap_less(grid, grid->heap[child + 1], grid->heap[child]))
+            child++;
+        if(!heap_less(grid, grid->heap[child], index))
+            break;
+        grid->heap[pos] = grid->heap[child];
+        grid->nodes[grid->heap[pos]].heapindex = pos;
+        pos = child;
     }
+    grid->heap[pos] = index;
+    grid->nodes[index].heapindex = pos;
+}
 
-    if(left_hit_wall && down_hit_wall) {
-        //SAFE to go down and left
-        u32 index = (current->x - 1) + (current->y + 1) * map->width;
-        if(current->x - 1 > 0 && current->y + 1 < map->height-1 && !blocked_tile(map->grid[index]))
-            successors.push_back({(f32)current->x - 1, (f32)current->y + 1});
-    }
+static inline
+void heap_push(PathGrid* grid, u32 index) {
+    grid->heap[grid->heapcount] = index;
+    heap_sift_up(grid, grid->heapcount++);
+}
 
-    if(down_hit_wall && right_hit_wall) {
-        //SAFE to go down and right
-        u32 index = (current->x + 1) + (current->y + 1) * map->width;
-        if(current->x + 1 < map->width-1 && current->y + 1 < map->height-1 && !blocked_tile(map->grid[index]))
-            successors.push_back({(f32)current->x + 1, (f32)current->y + 1});
+static inline
+u32 heap_pop(PathGrid* grid) {
+    u32 top = grid->heap[0];
+    grid->heapcount--;
+    if(grid->heapcount > 0) {
+        grid->heap[0] = grid->heap[grid->heapcount];
+        heap_sift_down(grid, 0);
     }
-
-    return successors;
+    grid->nodes[top].heapindex = -1;
+    return top;
 }
 
 static inline
-std::vector<vec2> pathfind(Map* map, vec2 start, vec2 dest) {
-    std::vector<NodePtr> open;
-    std::vector<NodePtr> closed;
-    NodePtr current;
-    open.push_back(NodePtr(new Node(start.x, start.y, NULL, 0)));
+i32 path_heuristic(i32 x0, i32 y0, i32 x1, i32 y1) {
+    i32 dx = abs(x0 - x1);
+    i32 dy = abs(y0 - y1);
+#ifdef DIAGONAL_ASTAR
+    //octile distance
+    return STRAIGHT_COST * (dx + dy) + (DIAGONAL_COST - 2 * STRAIGHT_COST) * (dx < dy ? dx : dy);
+#else
+    return STRAIGHT_COST * (dx + dy);
+#endif
+}
 
-    u32 tries = 0;
-    while(!open.empty() && tries < 1000) {
-        tries++;
+//the destination counts as walkable even when it is a wall (a tile queued
+//for mining), so searches can end next to it
+static inline
+bool path_walkable(Map* map, i32 x, i32 y, i32 destcell) {
+    if(x < 0 || y < 0 || x >= map->width || y >= map->height)
+        return false;
+    i32 cell = tile_index(map, x, y);
+    return cell == destcell || !cell_blocked(map, cell);
+}
 
-        std::sort(open.begin(), open.end(), compare_ptr_to_node);
-        current = open.back();
-        open.pop_back();
-        closed.push_back(current);
+//a dest walled in on all four sides can't be stepped onto or stood next to,
+//diagonals included since they may not cut corners. turning these away up
+//front saves a flood for the common case of a mine order deep in the rock.
+static inline
+bool dest_sealed(Map* map, vec2 start, vec2 dest) {
+    if((i32)start.x == (i32)dest.x && (i32)start.y == (i32)dest.y)
+        return false;
+    return all_sides_blocked(map, dest.x, dest.y);
+}
 
-        if(current->x == dest.x && current->y == dest.y)
-            return reconstruct_path(current);
+static inline
+void start_search(PathGrid* grid, Map* map, i32 x, i32 y, i32 destx, i32 desty) {
+    reset_path_grid(grid);
+    u32 index = push_node(grid, tile_index(map, x, y), x, y);
+    grid->nodes[index].fcost = path_heuristic(x, y, destx, desty);
+    heap_push(grid, index);
+}
 
-        //now use JUMP POINT SEARCH to eliminate nodes that can be skipped, and return new nodes
-        std::vector<vec2> successors = find_successors(map, current, start, dest);
-        for(u32 i = 0; i < successors.size(); ++i) {
-            vec2 currpt = successors[i];
-            process_successor(currpt.x, currpt.y, current->fcost + getDistanceE(currpt.x, currpt.y, dest.x, dest.y), current, open, closed);
-        }
+//relaxes the edge from the node "from" to the cell at (x, y)
+static inline
+void open_node(PathGrid* grid, Map* map, u32 from, i32 x, i32 y, i32 cost, i32 destx, i32 desty) {
+    i32 cell = tile_index(map, x, y);
+    i32 g = grid->nodes[from].gcost + cost;
+
+    u32 index = get_node(grid, cell);
+    if(index != NO_PARENT) {
+        //already closed, or already open with a cheaper route
+        Node* node = &grid->nodes[index];
+        if(node->heapindex == -1 || node->gcost <= g)
+            return;
+        node->fcost -= node->gcost - g;
+        node->gcost = g;
+        node->parent = from;
+        heap_sift_up(grid, node->heapindex);
+        return;
     }
 
-    std::vector<vec2> blank;
-    blank.push_back(start);
-    return blank;
+    index = push_node(grid, cell, x, y);
+    Node* node = &grid->nodes[index];
+    node->gcost = g;
+    node->fcost = g + path_heuristic(x, y, destx, desty);
+    node->parent = from;
+    heap_push(grid, index);
 }
 
+static inline
+void reconstruct_path(PathGrid* grid, u32 index, std::vector<vec2>* path) {
+    path->clear();
+    for(;;) {
+        Node* node = &grid->nodes[index];
+        path->push_back({(f32)node->x, (f32)node->y});
+        if(node->parent == NO_PARENT)
+            break;
+        index = node->parent;
+    }
+}
 
+//A* over the tile grid. the path runs from dest back to start, so units
+//consume it from the back. if dest is a wall (a tile queued for mining) the
+//path stops on the tile next to it instead. writing into an existing vector
+//reuses its capacity.
 static inline
-std::vector<vec2> pathfind_astar(Map* map, vec2 start, vec2 dest) {
+void pathfind_astar(Map* map, PathGrid* grid, vec2 start, vec2 dest, std::vector<vec2>* path) {
     if (start.x < 0 || start.y < 0 || start.x > map->width - 1 || start.y > map->height - 1)
         BMT_LOG(FATAL_ERROR, "vec2 start was out of bounds. start = (%f, %f)", start.x, start.y);
     if (dest.x < 0 || dest.y < 0 || dest.x > map->width - 1 || dest.y > map->height - 1)
         BMT_LOG(FATAL_ERROR, "vec2 dest was out of bounds. dest = (%f, %f)", dest.x, dest.y);
 
-    std::vector<NodePtr> open;
-    std::vector<NodePtr> closed;
-    NodePtr current;
-    open.push_back(NodePtr(new Node(start.x, start.y, NULL, 0)));
-
-    u16 tries = 0;
-    while (!open.empty() && tries < 650) {
-        //tries++;
+    i32 destx = dest.x;
+    i32 desty = dest.y;
+    i32 destcell = tile_index(map, destx, desty);
+    bool destblocked = cell_blocked(map, destcell);
 
-        std::sort(open.begin(), open.end(), compare_ptr_to_node);
-        current = open.back();
-        open.pop_back();
-        closed.push_back(current);
-
-        if (current->x == dest.x && current->y == dest.y) {
-            return reconstruct_path(current);
+    if(dest_sealed(map, start, dest)) {
+        path->clear();
+        path->push_back(start);
+        return;
+    }
+    start_search(grid, map, start.x, start.y, destx, desty);
+
+    for(u32 closed = 0; grid->heapcount > 0 && (grid->budget == 0 || closed < grid->budget); ++closed) {
+        u32 current = heap_pop(grid);
+        i32 x = grid->nodes[current].x;
+        i32 y = grid->nodes[current].y;
+        i32 cell = tile_index(map, x, y);
+
+        if(cell == destcell) {
+            if(destblocked && grid->nodes[current].parent != NO_PARENT)
+                current = grid->nodes[current].parent;
+            reconstruct_path(grid, current, path);
+            return;
         }
 
-        //NON-DIAGONALS
-        //if heuristic cost = -1 then the tile is blocked and cant be move to.
-        int x = current->x - 1;
-        int y = current->y;
-        if (x > map->width) continue;
-        if (y > map->height) continue;
-        if(!blocked_tile(map->grid[x + y * map->width]))
-            process_successor(x, y, current->fcost + getDistanceE(x, y, dest.x, dest.y), current, open, closed);
-        else if(dest.x == x && dest.y == y)
-            return reconstruct_path(current);
-
-        x = current->x + 1;
-        y = current->y;
-        if (x > map->width) continue;
-        if (y > map->height) continue;
-        if(!blocked_tile(map->grid[x + y * map->width]))
-            process_successor(x, y, current->fcost + getDistanceE(x, y, dest.x, dest.y), current, open, closed);
-        else if(dest.x == x && dest.y == y)
-            return reconstruct_path(current);
-
-        x = current->x;
-        y = current->y - 1;
-        if (x > map->width) continue;
-        if (y > map->height) continue;
-        if(!blocked_tile(map->grid[x + y * map->width]))
-            process_successor(x, y, current->fcost + getDistanceE(x, y, dest.x, dest.y), current, open, closed);
-        else if(dest.x == x && dest.y == y)
-            return reconstruct_path(current);
-
-        x = current->x;
-        y = current->y + 1;
-        if (x > map->width) continue;
-        if (y > map->height) continue;
-        if(!blocked_tile(map->grid[x + y * map->width]))
-            process_successor(x, y, current->fcost + getDistanceE(x, y, dest.x, dest.y), current, open, closed);
-        else if(dest.x == x && dest.y == y)
-            return reconstruct_path(current);
+        bool left = path_walkable(map, x - 1, y, destcell);
+        bool right = path_walkable(map, x + 1, y, destcell);
+        bool up = path_walkable(map, x, y - 1, destcell);
+        bool down = path_walkable(map, x, y + 1, destcell);
+
+        if(left)  open_node(grid, map, current, x - 1, y, STRAIGHT_COST, destx, desty);
+        if(right) open_node(grid, map, current, x + 1, y, STRAIGHT_COST, destx, desty);
+        if(up)    open_node(grid, map, current, x, y - 1, STRAIGHT_COST, destx, desty);
+        if(down)  open_node(grid, map, current, x, y + 1, STRAIGHT_COST, destx, desty);
 
 #ifdef DIAGONAL_ASTAR
-        //DIAGONALS
-        x = current->x + 1;
-        y = current->y + 1;
-        if (x > map->width) continue;
-        if (y > map->height) continue;
-        if(!blocked_tile(map->grid[x + y * map->width]))
-            process_successor(x, y, current->fcost + getDistanceE(x, y, dest.x, dest.y), current, open, closed);
-        else if(dest.x == x && dest.y == y)
-            return reconstruct_path(current);
-
-        x = current->x - 1;
-        y = current->y - 1;
-        if (x > map->width) continue;
-        if (y > map->height) continue;
-        if(!blocked_tile(map->grid[x + y * map->width]))
-            process_successor(x, y, current->fcost + getDistanceE(x, y, dest.x, dest.y), current, open, closed);
-        else if(dest.x == x && dest.y == y)
-            return reconstruct_path(current);
-
-        x = current->x - 1;
-        y = current->y + 1;
-        if (x > map->width) continue;
-        if (y > map->height) continue;
-        if(!blocked_tile(map->grid[x + y * map->width]))
-            process_successor(x, y, current->fcost+ getDistanceE(x, y, dest.x, dest.y), current, open, closed);
-        else if(dest.x == x && dest.y == y)
-            return reconstruct_path(current);
-
-        x = current->x + 1;
-        y = current->y - 1;
-        if (x > map->width) continue;
-        if (y > map->height) continue;
-        if(!blocked_tile(map->grid[x + y * map->width]))
-            process_successor(x, y, current->fcost + getDistanceE(x, y, dest.x, dest.y), current, open, closed);
-        else if(dest.x == x && dest.y == y)
-            return reconstruct_path(current);
+        //diagonals may not cut the corner of a wall
+        if(up && left && path_walkable(map, x - 1, y - 1, destcell))
+            open_node(grid, map, current, x - 1, y - 1, DIAGONAL_COST, destx, desty);
+        if(up && right && path_walkable(map, x + 1, y - 1, destcell))
+            open_node(grid, map, current, x + 1, y - 1, DIAGONAL_COST, destx, desty);
+        if(down && left && path_walkable(map, x - 1, y + 1, destcell))
+            open_node(grid, map, current, x - 1, y + 1, DIAGONAL_COST, destx, desty);
+        if(down && right && path_walkable(map, x + 1, y + 1, destcell))
+            open_node(grid, map, current, x + 1, y + 1, DIAGONAL_COST, destx, desty);
 #endif
-
-    }
-    if (tries == 650) {
-        return reconstruct_path(current);
     }
-    std::vector<vec2> blank;
-    blank.push_back(start);
-    return blank;
+
+    path->clear();
+    path->push_back(start);
 }
 
-//
-//   MAP
-//
+static inline
+void pathfind_astar(Map* map, vec2 start, vec2 dest, std::vector<vec2>* path) {
+    pathfind_astar(map, get_path_grid(map), start, dest, path);
+}
 
 static inline
-void place_random_room(Map* map, u32 width, u32 height, vec2 origin, i32* x, i32* y) {
-    *x = 0;
-    *y = 0;
-    do {
-        *x = random_int(2, map->width-height-2);
-        *y = random_int(2, map->height-width-2);
-    } while(*x + width > map->width && *y + height > map->height&& getDistanceE(*x, *y, origin.x, origin.y) < 6 && getDistanceE(*x, *y, origin.x, origin.y) > 4);
+std::vector<vec2> pathfind_astar(Map* map, vec2 start, vec2 dest) {
+    std::vector<vec2> path;
+    pathfind_astar(map, get_path_grid(map), start, dest, &path);
+    return path;
+}
+
+//jump point search. same results as A* but only pushes the nodes where the
+//path can turn, which skips the long runs of open corridor. follows the
+//DIAGONAL_ASTAR switch, and like A* never cuts the corner of a wall.
+
+static inline
+i32 sign(i32 v) {
+    return (v > 0) - (v < 0);
+}
 
-    if(origin.x != -1 && origin.y != -1) {
-        std::vector<vec2> path = pathfind_astar(map, {(f32)*x, (f32)*y}, origin);
-        for(u32 i = 0; i < path.size(); ++i){
-            u32 index = path[i].x + path[i].y * map->width;
-            map->grid[index] = 0;
+//scans in a straight line from (x, y). returns the cell of the next jump
+//point, or -1 if the scan runs into a wall first.
+static inline
+i32 jump_straight(Map* map, i32 x, i32 y, i32 dx, i32 dy, i32 destcell) {
+    for(;;) {
+        x += dx;
+        y += dy;
+        if(!path_walkable(map, x, y, destcell))
+            return -1;
+        i32 cell = tile_index(map, x, y);
+        if(cell == destcell)
+            return cell;
+
+        //forced neighbors: a tile to the side that could not be reached
+        //around the tile we came from
+        if(dx != 0) {
+            if((path_walkable(map, x, y - 1, destcell) && !path_walkable(map, x - dx, y - 1, destcell)) ||
+               (path_walkable(map, x, y + 1, destcell) && !path_walkable(map, x - dx, y + 1, destcell)))
+                return cell;
+        } else {
+            if((path_walkable(map, x - 1, y, destcell) && !path_walkable(map, x - 1, y - dy, destcell)) ||
+               (path_walkable(map, x + 1, y, destcell) && !path_walkable(map, x + 1, y - dy, destcell)))
+                return cell;
+#ifndef DIAGONAL_ASTAR
+            //without diagonals, vertical runs stop wherever a horizontal
+            //scan would find something
+            if(jump_straight(map, x, y, 1, 0, destcell) != -1 || jump_straight(map, x, y, -1, 0, destcell) != -1)
+                return cell;
+#endif
         }
     }
-
-    for(u32 i = *x; i < *x + width; ++i)
-        for(u32 j = *y; j < *y + height; ++j)
-            map->grid[i + j * map->width] = 0;
 }
 
 static inline
-Map load_random_map(i32 width, i32 height) {
-    Map map = {0};
+i32 jump(Map* map, i32 x, i32 y, i32 dx, i32 dy, i32 destcell) {
+    if(dx == 0 || dy == 0)
+        return jump_straight(map, x, y, dx, dy, destcell);
 
-    map.width = width;
-    map.height = height;
-    map.grid = (i32*)malloc(sizeof(i32) * (map.width * map.height));
+    for(;;) {
+        x += dx;
+        y += dy;
+        if(!path_walkable(map, x, y, destcell))
+            return -1;
+        i32 cell = tile_index(map, x, y);
+        if(cell == destcell)
+            return cell;
+
+        //diagonal runs stop wherever either straight scan finds something
+        if(jump_straight(map, x, y, dx, 0, destcell) != -1 || jump_straight(map, x, y, 0, dy, destcell) != -1)
+            return cell;
+
+        //the next diagonal step may not cut a corner
+        if(!path_walkable(map, x + dx, y, destcell) || !path_walkable(map, x, y + dy, destcell))
+            return -1;
+    }
+}
 
-    for(u32 i = 0; i < width * height; ++i)
-        map.grid[i] = 8;
+//directions worth scanning from a node. at most eight.
+struct JumpDirections {
+    i32 dx[8];
+    i32 dy[8];
+    u32 count;
+};
 
-    i32 x = 0;
-    i32 y = 0;
-    place_random_room(&map, 5, 5, {-1, -1}, &x, &y);
-    place_random_room(&map, 8, 8, {(f32)x, (f32)y}, &x, &y);
+static inline
+void add_direction(JumpDirections* dirs, i32 dx, i32 dy) {
+    dirs->dx[dirs->count] = dx;
+    dirs->dy[dirs->count] = dy;
+    dirs->count++;
+}
 
-    for(u32 i = 0; i < width*height; ++i) {
-        if(map.grid[i] == 8)
-            map.grid[i] = 0;
-        else
-            map.grid[i] = 8;
+static inline
+void prune_directions(Map* map, Node* node, Node* parent, i32 destcell, JumpDirections* dirs) {
+    i32 x = node->x;
+    i32 y = node->y;
+    dirs->count = 0;
+
+    if(parent == NULL) {
+        //the start node scans everywhere
+        bool left = path_walkable(map, x - 1, y, destcell);
+        bool right = path_walkable(map, x + 1, y, destcell);
+        bool up = path_walkable(map, x, y - 1, destcell);
+        bool down = path_walkable(map, x, y + 1, destcell);
+        if(left)  add_direction(dirs, -1, 0);
+        if(right) add_direction(dirs, 1, 0);
+        if(up)    add_direction(dirs, 0, -1);
+        if(down)  add_direction(dirs, 0, 1);
+#ifdef DIAGONAL_ASTAR
+        if(up && left && path_walkable(map, x - 1, y - 1, destcell))    add_direction(dirs, -1, -1);
+        if(up && right && path_walkable(map, x + 1, y - 1, destcell))   add_direction(dirs, 1, -1);
+        if(down && left && path_walkable(map, x - 1, y + 1, destcell))  add_direction(dirs, -1, 1);
+        if(down && right && path_walkable(map, x + 1, y + 1, destcell)) add_direction(dirs, 1, 1);
+#endif
+        return;
     }
 
-    orient_tiles(&map);
+    i32 dx = sign(x - parent->x);
+    i32 dy = sign(y - parent->y);
 
-    return map;
+#ifdef DIAGONAL_ASTAR
+    if(dx != 0 && dy != 0) {
+        bool vertical = path_walkable(map, x, y + dy, destcell);
+        bool horizontal = path_walkable(map, x + dx, y, destcell);
+        if(vertical) add_direction(dirs, 0, dy);
+        if(horizontal) add_direction(dirs, dx, 0);
+        if(vertical && horizontal) add_direction(dirs, dx, dy);
+    } else if(dx != 0) {
+        bool next = path_walkable(map, x + dx, y, destcell);
+        bool up = path_walkable(map, x, y - 1, destcell);
+        bool down = path_walkable(map, x, y + 1, destcell);
+        if(next) {
+            add_direction(dirs, dx, 0);
+            if(up) add_direction(dirs, dx, -1);
+            if(down) add_direction(dirs, dx, 1);
+        }
+        if(up) add_direction(dirs, 0, -1);
+        if(down) add_direction(dirs, 0, 1);
+    } else {
+        bool next = path_walkable(map, x, y + dy, destcell);
+        bool left = path_walkable(map, x - 1, y, destcell);
+        bool right = path_walkable(map, x + 1, y, destcell);
+        if(next) {
+            add_direction(dirs, 0, dy);
+            if(left) add_direction(dirs, -1, dy);
+            if(right) add_direction(dirs, 1, dy);
+        }
+        if(left) add_direction(dirs, -1, 0);
+        if(right) add_direction(dirs, 1, 0);
+    }
+#else
+    if(dx != 0) {
+        if(path_walkable(map, x + dx, y, destcell)) add_direction(dirs, dx, 0);
+        if(path_walkable(map, x, y - 1, destcell))  add_direction(dirs, 0, -1);
+        if(path_walkable(map, x, y + 1, destcell))  add_direction(dirs, 0, 1);
+    } else {
+        if(path_walkable(map, x, y + dy, destcell)) add_direction(dirs, 0, dy);
+        if(path_walkable(map, x - 1, y, destcell))  add_direction(dirs, -1, 0);
+        if(path_walkable(map, x + 1, y, destcell))  add_direction(dirs, 1, 0);
+    }
+#endif
 }
 
+//jump points are joined by straight or diagonal runs, so fill in every tile
+//between them. skipfirst drops the tile at index (a blocked dest).
 static inline
-void draw_map(RenderBatch* batch, Map* map, Texture tileset) {
-    i32 x0 = (-map->x / TILE_SIZE);
-    i32 x1 = (-map->x / TILE_SIZE) + (get_virtual_width() / TILE_SIZE) + 1;
-    i32 y0 = (-map->y / TILE_SIZE);
-    i32 y1 = (-map->y / TILE_SIZE) + (get_virtual_height() / TILE_SIZE) + 2;
+void reconstruct_jump_path(PathGrid* grid, u32 index, bool skipfirst, std::vector<vec2>* path) {
+    path->clear();
+    Node* node = &grid->nodes[index];
+    i32 x = node->x;
+    i32 y = node->y;
+    if(!skipfirst)
+        path->push_back({(f32)x, (f32)y});
+
+    while(node->parent != NO_PARENT) {
+        node = &grid->nodes[node->parent];
+        i32 dx = sign(node->x - x);
+        i32 dy = sign(node->y - y);
+        while(x != node->x || y != node->y) {
+            x += dx;
+            y += dy;
+            path->push_back({(f32)x, (f32)y});
+        }
+    }
 
-    clamp(&x0, 0, map->width);
-    clamp(&x1, 0, map->width);
-    clamp(&y0, 0, map->height);
-    clamp(&y1, 0, map->height);
+    if(path->size() == 0)
+        path->push_back({(f32)x, (f32)y});
+}
+
+static inline
+void pathfind_jps(Map* map, PathGrid* grid, vec2 start, vec2 dest, std::vector<vec2>* path) {
+    if (start.x < 0 || start.y < 0 || start.x > map->width - 1 || start.y > map->height - 1)
+        BMT_LOG(FATAL_ERROR, "vec2 start was out of bounds. start = (%f, %f)", start.x, start.y);
+    if (dest.x < 0 || dest.y < 0 || dest.x > map->width - 1 || dest.y > map->height - 1)
+        BMT_LOG(FATAL_ERROR, "vec2 dest was out of bounds. dest = (%f, %f)", dest.x, dest.y);
 
-    Rect dest = {0, 0, (f32)TILE_SIZE, (f32)TILE_SIZE};
-    Rect src = {0, 0, (f32)TILE_SIZE, (f32)TILE_SIZE};
+    i32 destx = dest.x;
+    i32 desty = dest.y;
+    i32 destcell = tile_index(map, destx, desty);
+    bool destblocked = cell_blocked(map, destcell);
 
-    for(u32 x = x0; x < x1; ++x) {
-        for(u32 y = y0; y < y1; ++y) {
-            i32 id = map->grid[x + y * map->width];
+    if(dest_sealed(map, start, dest)) {
+        path->clear();
+        path->push_back(start);
+        return;
+    }
+    start_search(grid, map, start.x, start.y, destx, desty);
+
+    JumpDirections dirs;
+    for(u32 closed = 0; grid->heapcount > 0 && (grid->budget == 0 || closed < grid->budget); ++closed) {
+        u32 current = heap_pop(grid);
+        i32 x = grid->nodes[current].x;
+        i32 y = grid->nodes[current].y;
 
-            dest.x = (x * TILE_SIZE) + map->x;
-            dest.y = (y * TILE_SIZE) + map->y;
-            src.x = (id % TILESET_WIDTH) * TILE_SIZE;
-            src.y = (id / TILESET_WIDTH) * TILE_SIZE;
+        if((i32)tile_index(map, x, y) == destcell) {
+            reconstruct_jump_path(grid, current, destblocked, path);
+            return;
+        }
 
-            draw_texture_EX(batch, tileset, src, dest);
+        u32 parent = grid->nodes[current].parent;
+        prune_directions(map, &grid->nodes[current], parent == NO_PARENT ? NULL : &grid->nodes[parent], destcell, &dirs);
+
+        for(u32 i = 0; i < dirs.count; ++i) {
+            i32 cell = jump(map, x, y, dirs.dx[i], dirs.dy[i], destcell);
+            if(cell == -1)
+                continue;
+            i32 jx, jy;
+            tile_position(map, cell, &jx, &jy);
+            //runs are straight or diagonal, so the heuristic is the exact cost
+            open_node(grid, map, current, jx, jy, path_heuristic(x, y, jx, jy), destx, desty);
         }
     }
-    if(is_key_down(KEY_LEFT))
-        map->x += SCROLL_SPEED;
-    if(is_key_down(KEY_RIGHT))
-        map->x -= SCROLL_SPEED;
-    if(is_key_down(KEY_DOWN))
-        map->y -= SCROLL_SPEED;
-    if(is_key_down(KEY_UP))
-        map->y += SCROLL_SPEED;
 
+    path->clear();
+    path->push_back(start);
+}
+
+static inline
+void pathfind_jps(Map* map, vec2 start, vec2 dest, std::vector<vec2>* path) {
+    pathfind_jps(map, get_path_grid(map), start, dest, path);
 }
 
+enum Pathfinder {
+    PATHFINDER_ASTAR,
+    PATHFINDER_JPS,
+    PATHFINDER_HPA, //see hpa.h
+};
+
+//
+//   MAP
+//
+
 static inline
 void dispose_map(Map* map) {
     free(map->grid);
+    free(map->blocked);
+    free(map->terrain);
+    free(map->chunkversions);
+    free(map->orientbuffer);
+    if(map->paths != NULL)
+        dispose_path_grid(map->paths);
 }
 
 #endif
@@ -0,0 +1,392 @@
+#ifndef MAPGEN_H
+#define MAPGEN_H
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include "core.h"
+#include "map.h"
+
+//
+//   DUNGEON GENERATOR
+//
+
+//the map is cut into square regions that are generated on their own, each
+//from its own rng, so they can go wide across cores and the result does not
+//depend on how many there are. inside a region bsp splits the space into
+//leaves, every leaf gets a room or a cellular automata cave, and a minimum
+//spanning tree plus a few extra edges joins them with corridors. neighboring
+//regions are stitched together afterwards on one thread.
+
+const i32 GEN_FLOOR = 8;
+const i32 GEN_WALL = 0;
+const i32 GEN_REGION_SIZE = 128; //a multiple of CHUNK_SIZE, so regions never share a chunk
+const i32 GEN_MAX_LEAF = 28;
+const i32 GEN_MIN_LEAF = 10;
+const i32 GEN_MIN_ROOM = 4;
+const i32 GEN_MIN_CAVE_LEAF = 14;
+const i32 GEN_CAVE_CHANCE = 6; //one leaf in this many grows a cave instead of a room
+const i32 GEN_CAVE_FILL = 45; //percent of a cave that starts out as wall
+const i32 GEN_CAVE_STEPS = 4;
+const i32 GEN_MIN_CAVE = 12; //caves whose biggest hollow is smaller become rooms
+const i32 GEN_LOOP_CHANCE = 8; //one room in this many gets a second corridor
+
+struct DungeonGenStats {
+    vec2 start; //a floor tile in the first room or cave, somewhere safe to put units. the center if there's no floor
+    u32 regions;
+    u32 rooms;
+    u32 caves;
+    u32 corridors;
+    u32 threads;
+    f64 seconds;
+};
+
+struct GenRegion {
+    i32 x0, y0, x1, y1; //tiles x0 to x1 - 1, y0 to y1 - 1
+    std::vector<vec2> anchors; //a floor tile in each room and cave
+    u32 rooms;
+    u32 caves;
+    u32 corridors;
+};
+
+//runs job(0) to job(count - 1) spread over threads, in no particular order
+static inline
+void parallel_for(u32 count, u32 threads, const std::function<void(u32)>& job) {
+    std::atomic<u32> next(0);
+    auto worker = [&]() {
+        for(u32 i = next++; i < count; i = next++)
+            job(i);
+    };
+
+    std::vector<std::thread> pool;
+    for(u32 i = 1; i < threads; ++i)
+        pool.push_back(std::thread(worker));
+    worker();
+    for(u32 i = 0; i < pool.size(); ++i)
+        pool[i].join();
+}
+
+//an L of floor from a to b, bending at random
+static inline
+void carve_corridor(Map* map, Rng* rng, vec2 a, vec2 b) {
+    i32 ax = a.x, ay = a.y;
+    i32 bx = b.x, by = b.y;
+    bool across = random_int(rng, 0, 1) == 0; //along a's row first, else down a's column
+
+    for(i32 x = std::min(ax, bx); x <= std::max(ax, bx); ++x)
+        set_tile(map, x, across ? ay : by, GEN_FLOOR);
+    for(i32 y = std::min(ay, by); y <= std::max(ay, by); ++y)
+        set_tile(map, across ? bx : ax, y, GEN_FLOOR);
+}
+
+//smooths noise into a cave with the 4-5 rule and keeps only its biggest
+//hollow. false if that is too small to bother with.
+static inline
+bool carve_cave(Map* map, Rng* rng, i32 x0, i32 y0, i32 width, i32 height, vec2* anchor) {
+    std::vector<u8> walls(width * height);
+    std::vector<u8> next(width * height);
+    for(i32 y = 0; y < height; ++y) {
+        for(i32 x = 0; x < width; ++x) {
+            bool edge = x == 0 || y == 0 || x == width - 1 || y == height - 1;
+            walls[x + y * width] = edge || random_int(rng, 0, 99) < GEN_CAVE_FILL;
+        }
+    }
+
+    for(i32 step = 0; step < GEN_CAVE_STEPS; ++step) {
+        for(i32 y = 0; y < height; ++y) {
+            for(i32 x = 0; x < width; ++x) {
+                if(x == 0 || y == 0 || x == width - 1 || y == height - 1) {
+                    next[x + y * width] = 1;
+                    continue;
+                }
+                i32 count = 0;
+                for(i32 j = -1; j <= 1; ++j)
+                    for(i32 i = -1; i <= 1; ++i)
+                        count += (i != 0 || j != 0) && walls[(x + i) + (y + j) * width];
+                u8 wall = walls[x + y * width];
+                next[x + y * width] = wall ? count >= 4 : count >= 5;
+            }
+        }
+        walls.swap(next);
+    }
+
+    //label the hollows, remember the biggest
+    std::vector<i32> labels(width * height, -1);
+    std::vector<i32> stack;
+    i32 best = -1;
+    i32 bestsize = 0;
+    i32 label = 0;
+    for(i32 i = 0; i < width * height; ++i) {
+        if(walls[i] || labels[i] != -1)
+            continue;
+        i32 size = 0;
+        labels[i] = label;
+        stack.push_back(i);
+        while(stack.size() > 0) {
+            i32 cell = stack.back();
+            stack.pop_back();
+            size++;
+            i32 x = cell % width;
+            i32 y = cell / width;
+            i32 neighbors[4] = {cell - 1, cell + 1, cell - width, cell + width};
+            bool inside[4] = {x > 0, x < width - 1, y > 0, y < height - 1};
+            for(i32 n = 0; n < 4; ++n) {
+                if(inside[n] && !walls[neighbors[n]] && labels[neighbors[n]] == -1) {
+                    labels[neighbors[n]] = label;
+                    stack.push_back(neighbors[n]);
+                }
+            }
+        }
+        if(size > bestsize) {
+            best = label;
+            bestsize = size;
+        }
+        label++;
+    }
+    if(bestsize < GEN_MIN_CAVE)
+        return false;
+
+    i32 bestdistance = INT_MAX;
+    for(i32 y = 0; y < height; ++y) {
+        for(i32 x = 0; x < width; ++x) {
+            if(labels[x + y * width] != best)
+                continue;
+            set_tile(map, x0 + x, y0 + y, GEN_FLOOR);
+            i32 distance = abs(2 * x - width) + abs(2 * y - height);
+            if(distance < bestdistance) {
+                bestdistance = distance;
+                *anchor = V2(x0 + x, y0 + y);
+            }
+        }
+    }
+    return true;
+}
+
+//prim's over the anchors, then an extra corridor to the second nearest anchor
+//now and then so not every route is a dead end
+static inline
+void connect_anchors(Map* map, Rng* rng, GenRegion* region) {
+    std::vector<vec2>& anchors = region->anchors;
+    u32 count = anchors.size();
+    if(count < 2)
+        return;
+
+    std::vector<i32> distance(count, INT_MAX);
+    std::vector<u32> parent(count, 0);
+    std::vector<u8> intree(count, 0);
+    distance[0] = 0;
+    for(u32 added = 0; added < count; ++added) {
+        u32 nearest = count;
+        for(u32 i = 0; i < count; ++i)
+            if(!intree[i] && (nearest == count || distance[i] < distance[nearest]))
+                nearest = i;
+        intree[nearest] = 1;
+        if(nearest != 0) {
+            carve_corridor(map, rng, anchors[parent[nearest]], anchors[nearest]);
+            region->corridors++;
+        }
+        for(u32 i = 0; i < count; ++i) {
+            i32 d = abs(anchors[i].x - anchors[nearest].x) + abs(anchors[i].y - anchors[nearest].y);
+            if(!intree[i] && d < distance[i]) {
+                distance[i] = d;
+                parent[i] = nearest;
+            }
+        }
+    }
+
+    if(count < 3)
+        return;
+    for(u32 i = 0; i < count; ++i) {
+        if(random_int(rng, 0, GEN_LOOP_CHANCE - 1) != 0)
+            continue;
+        u32 first = count, second = count;
+        i32 firstdistance = INT_MAX, seconddistance = INT_MAX;
+        for(u32 j = 0; j < count; ++j) {
+            if(j == i)
+                continue;
+            i32 d = abs(anchors[i].x - anchors[j].x) + abs(anchors[i].y - anchors[j].y);
+            if(d < firstdistance) {
+                second = first;
+                seconddistance = firstdistance;
+                first = j;
+                firstdistance = d;
+            } else if(d < seconddistance) {
+                second = j;
+                seconddistance = d;
+            }
+        }
+        carve_corridor(map, rng, anchors[i], anchors[second]);
+        region->corridors++;
+    }
+}
+
+//only writes tiles inside the region
+static inline
+void generate_region(Map* map, GenRegion* region, u64 seed) {
+    Rng rng;
+    seed_rng(&rng, seed);
+
+    //keep the outermost ring of the map solid
+    i32 x0 = std::max(region->x0, 1);
+    i32 y0 = std::max(region->y0, 1);
+    i32 x1 = std::min(region->x1, map->width - 1);
+    i32 y1 = std::min(region->y1, map->height - 1);
+
+    std::vector<Rect> leaves;
+    leaves.push_back({(f32)x0, (f32)y0, (f32)(x1 - x0), (f32)(y1 - y0)});
+    while(leaves.size() > 0) {
+        Rect leaf = leaves.back();
+        leaves.pop_back();
+        i32 lx = leaf.x, ly = leaf.y, lw = leaf.width, lh = leaf.height;
+
+        if(lw > GEN_MAX_LEAF || lh > GEN_MAX_LEAF) {
+            if(lw >= lh) {
+                i32 split = random_int(&rng, GEN_MIN_LEAF, lw - GEN_MIN_LEAF);
+                leaves.push_back({(f32)lx, (f32)ly, (f32)split, (f32)lh});
+                leaves.push_back({(f32)(lx + split), (f32)ly, (f32)(lw - split), (f32)lh});
+            } else {
+                i32 split = random_int(&rng, GEN_MIN_LEAF, lh - GEN_MIN_LEAF);
+                leaves.push_back({(f32)lx, (f32)ly, (f32)lw, (f32)split});
+                leaves.push_back({(f32)lx, (f32)(ly + split), (f32)lw, (f32)(lh - split)});
+            }
+            continue;
+        }
+
+        vec2 anchor;
+        if(lw >= GEN_MIN_CAVE_LEAF && lh >= GEN_MIN_CAVE_LEAF && random_int(&rng, 0, GEN_CAVE_CHANCE - 1) == 0 &&
+           carve_cave(map, &rng, lx, ly, lw, lh, &anchor)) {
+            region->anchors.push_back(anchor);
+            region->caves++;
+            continue;
+        }
+
+        //a tile of wall on every side keeps rooms in neighboring leaves apart
+        if(lw < GEN_MIN_ROOM + 2 || lh < GEN_MIN_ROOM + 2)
+            continue;
+        i32 w = random_int(&rng, GEN_MIN_ROOM, lw - 2);
+        i32 h = random_int(&rng, GEN_MIN_ROOM, lh - 2);
+        i32 x = random_int(&rng, lx + 1, lx + lw - 1 - w);
+        i32 y = random_int(&rng, ly + 1, ly + lh - 1 - h);
+        for(i32 j = y; j < y + h; ++j)
+            for(i32 i = x; i < x + w; ++i)
+                set_tile(map, i, j, GEN_FLOOR);
+        region->anchors.push_back(V2(x + w / 2, y + h / 2));
+        region->rooms++;
+    }
+
+    connect_anchors(map, &rng, region);
+}
+
+//the anchor closest to a point, for joining regions across their shared edge
+static inline
+bool nearest_anchor(GenRegion* region, i32 x, i32 y, vec2* out) {
+    i32 best = INT_MAX;
+    for(u32 i = 0; i < region->anchors.size(); ++i) {
+        i32 d = abs(region->anchors[i].x - x) + abs(region->anchors[i].y - y);
+        if(d < best) {
+            best = d;
+            *out = region->anchors[i];
+        }
+    }
+    return best != INT_MAX;
+}
+
+//a walled dungeon of rooms, caves and corridors, every floor tile reachable
+//from every other. the same rng state gives the same map on any machine and
+//any number of threads, threads of 0 uses one per core.
+static inline
+Map generate_dungeon(i32 width, i32 height, u32 threads, Rng* rng, DungeonGenStats* stats) {
+    u64 begin = get_nanoseconds();
+    u64 seed = ((u64)next_random(rng) << 32) | next_random(rng);
+    Map map = create_map(width, height, GEN_WALL);
+
+    //a leftover strip too thin for rooms goes to the last region instead
+    i32 regionswide = std::max(width / GEN_REGION_SIZE, 1);
+    i32 regionshigh = std::max(height / GEN_REGION_SIZE, 1);
+    std::vector<GenRegion> regions(regionswide * regionshigh);
+    for(i32 ry = 0; ry < regionshigh; ++ry) {
+        for(i32 rx = 0; rx < regionswide; ++rx) {
+            GenRegion* region = &regions[rx + ry * regionswide];
+            region->x0 = rx * GEN_REGION_SIZE;
+            region->y0 = ry * GEN_REGION_SIZE;
+            region->x1 = rx == regionswide - 1 ? width : (rx + 1) * GEN_REGION_SIZE;
+            region->y1 = ry == regionshigh - 1 ? height : (ry + 1) * GEN_REGION_SIZE;
+            region->rooms = 0;
+            region->caves = 0;
+            region->corridors = 0;
+        }
+    }
+
+    if(threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    threads = std::min(threads, (u32)regions.size());
+    parallel_for(regions.size(), threads, [&](u32 i) {
+        generate_region(&map, &regions[i], seed + i * 0x9E3779B97F4A7C15ull);
+    });
+
+    //corridors between neighbors cross region lines, so they go one at a time
+    Rng stitch;
+    seed_rng(&stitch, seed ^ 0xD1B54A32D192ED03ull);
+    u32 corridors = 0;
+    for(i32 ry = 0; ry < regionshigh; ++ry) {
+        for(i32 rx = 0; rx < regionswide; ++rx) {
+            GenRegion* region = &regions[rx + ry * regionswide];
+            vec2 a, b;
+            if(rx + 1 < regionswide) {
+                GenRegion* right = &regions[rx + 1 + ry * regionswide];
+                i32 y = (region->y0 + region->y1) / 2;
+                if(nearest_anchor(region, region->x1, y, &a) && nearest_anchor(right, region->x1, y, &b)) {
+                    carve_corridor(&map, &stitch, a, b);
+                    corridors++;
+                }
+            }
+            if(ry + 1 < regionshigh) {
+                GenRegion* below = &regions[rx + (ry + 1) * regionswide];
+                i32 x = (region->x0 + region->x1) / 2;
+                if(nearest_anchor(region, x, region->y1, &a) && nearest_anchor(below, x, region->y1, &b)) {
+                    carve_corridor(&map, &stitch, a, b);
+                    corridors++;
+                }
+            }
+        }
+    }
+
+    //autotiling reads a tile's neighbors but only writes the tile, so bands of
+    //rows can go side by side, each with its own scratch
+    u32 bands = (height + GEN_REGION_SIZE - 1) / GEN_REGION_SIZE;
+    parallel_for(bands, std::min(threads, bands), [&](u32 i) {
+        std::vector<u8> buffer(orient_buffer_size(width));
+        orient_tiles_region(&map, 0, i * GEN_REGION_SIZE, width - 1, std::min((i32)(i + 1) * GEN_REGION_SIZE, height) - 1, buffer.data());
+    });
+
+    stats->start = V2(width / 2, height / 2);
+    stats->regions = regions.size();
+    stats->rooms = 0;
+    stats->caves = 0;
+    stats->corridors = corridors;
+    stats->threads = threads;
+    for(u32 i = 0; i < regions.size(); ++i) {
+        stats->rooms += regions[i].rooms;
+        stats->caves += regions[i].caves;
+        stats->corridors += regions[i].corridors;
+    }
+    //the first region with a room, else any open tile. a map with no floor at
+    //all keeps the center
+    bool found = false;
+    for(u32 i = 0; i < regions.size() && !found; ++i)
+        found = nearest_anchor(&regions[i], 0, 0, &stats->start);
+    for(i32 y = 0; y < height && !found; ++y) {
+        for(i32 x = 0; x < width && !found; ++x) {
+            if(!tile_blocked(&map, x, y)) {
+                stats->start = V2(x, y);
+                found = true;
+            }
+        }
+    }
+    stats->seconds = (get_nanoseconds() - begin) / 1e9;
+    return map;
+}
+
+#endif
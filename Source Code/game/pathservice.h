@@ -0,0 +1,280 @@
+#ifndef PATHSERVICE_H
+#define PATHSERVICE_H
+
+#include <vector>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "core.h"
+#include "map.h"
+#include "hpa.h"
+
+//
+//   PATH SERVICE
+//
+
+//units hand their searches to a pool of worker threads and pick the result up
+//on a later tick. workers never read the live map, they read a copy of its
+//passability taken at a given map version. a copy stays alive until the last
+//request using it is done, and results from an older version than the live
+//map are thrown away. a retired copy is kept as a spare and the next one is
+//made by copying over it just the chunks that changed since, so a dig costs a
+//chunk's worth of copying rather than the whole map. a service serves one map
+//from start_path_service to stop_path_service.
+//
+//each worker keeps its own cluster graph for PATHFINDER_HPA. copies carry the
+//chunk versions, so a worker's graph catches up with only the clusters that
+//changed since its last search, see repair_cluster_graph.
+//
+//in lockstep every search asked for during a tick is handed back at the start
+//of the next one, whatever the thread timing, so seeded runs repeat exactly.
+
+struct GridSnapshot {
+    Map map; //owns copies of blocked, terrain and chunkversions. no grid, no pathfinder reads graphics
+    u32 refs; //guarded by the service lock
+};
+
+struct PathRequest {
+    u32 ticket;
+    u32 unit; //handed back on the result, e.g. a UnitHandle
+    vec2 start;
+    vec2 dest;
+    Pathfinder pathfinder;
+    GridSnapshot* snapshot;
+};
+
+struct PathResult {
+    u32 ticket;
+    u32 unit;
+    u32 version; //map version the path was found on
+    std::vector<vec2> path;
+};
+
+struct PathService {
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable idle; //signalled when the last search in flight finishes
+    std::deque<PathRequest> requests;
+    std::vector<PathResult> results;
+    GridSnapshot* snapshot; //copy of the newest version seen
+    GridSnapshot* spare; //a retired copy, brought up to date for the next version
+    u32 nextticket;
+    u32 busy; //requests taken by a worker and not finished yet
+    bool lockstep;
+    bool quit;
+
+    //guarded by the lock, for profiling
+    u64 searchtime; //nanoseconds workers spent searching, all threads summed
+    u32 searches;
+};
+
+static inline
+void dispose_snapshot(GridSnapshot* snapshot) {
+    dispose_map(&snapshot->map);
+    free(snapshot);
+}
+
+//call with the service lock held
+static inline
+void release_snapshot(PathService* service, GridSnapshot* snapshot) {
+    snapshot->refs--;
+    if(snapshot->refs == 0 && snapshot != service->snapshot) {
+        if(service->spare == NULL)
+            service->spare = snapshot;
+        else
+            dispose_snapshot(snapshot);
+    }
+}
+
+//a copy of map for the workers, made over the spare when there is one. set_cell
+//bumps a chunk's version whenever a tile in it changes, so chunks whose version
+//matches the spare's are already right. call with the service lock held.
+static inline
+GridSnapshot* take_snapshot(PathService* service, Map* map) {
+    u32 chunks = map->chunkswide * map->chunkshigh;
+    GridSnapshot* snapshot = service->spare;
+    service->spare = NULL;
+    if(snapshot != NULL && (snapshot->map.chunkswide != map->chunkswide || snapshot->map.chunkshigh != map->chunkshigh)) {
+        dispose_snapshot(snapshot);
+        snapshot = NULL;
+    }
+
+    bool whole = snapshot == NULL;
+    if(whole) {
+        u32 size = map_cells(map);
+        snapshot = (GridSnapshot*)malloc(sizeof(GridSnapshot));
+        snapshot->map.blocked = (u64*)malloc(sizeof(u64) * (size / 64));
+        snapshot->map.terrain = (u8*)malloc(size);
+        snapshot->map.chunkversions = (u32*)malloc(sizeof(u32) * chunks);
+    }
+
+    u64* blocked = snapshot->map.blocked;
+    u8* terrain = snapshot->map.terrain;
+    u32* chunkversions = snapshot->map.chunkversions; //the live map's when each chunk was copied
+    snapshot->map = *map;
+    snapshot->map.grid = NULL;
+    snapshot->map.blocked = blocked;
+    snapshot->map.terrain = terrain;
+    snapshot->map.chunkversions = chunkversions;
+    snapshot->map.paths = NULL;
+    snapshot->map.orientbuffer = NULL;
+    snapshot->map.orientcapacity = 0;
+    snapshot->refs = 0;
+
+    for(u32 chunk = 0; chunk < chunks; ++chunk) {
+        if(!whole && chunkversions[chunk] == map->chunkversions[chunk])
+            continue;
+        chunkversions[chunk] = map->chunkversions[chunk];
+        u32 cell = chunk * CHUNK_AREA;
+        memcpy(blocked + cell / 64, map->blocked + cell / 64, CHUNK_AREA / 8);
+        memcpy(terrain + cell, map->terrain + cell, CHUNK_AREA);
+    }
+    return snapshot;
+}
+
+static inline
+void path_worker(PathService* service) {
+    PathGrid* grid = NULL;
+    ClusterGraph clusters = {}; //built on this worker's first PATHFINDER_HPA search
+    PathResult result;
+
+    for(;;) {
+        std::unique_lock<std::mutex> guard(service->lock);
+        while(!service->quit && service->requests.empty())
+            service->wake.wait(guard);
+        if(service->quit)
+            break;
+        PathRequest request = service->requests.front();
+        service->requests.pop_front();
+        service->busy++;
+        guard.unlock();
+
+        Map* map = &request.snapshot->map;
+        u32 size = map_cells(map);
+        if(grid == NULL || grid->size != size) {
+            if(grid != NULL)
+                dispose_path_grid(grid);
+            grid = create_path_grid(size);
+        }
+
+        u64 start = get_nanoseconds();
+        result.path.clear();
+        switch(request.pathfinder) {
+            case PATHFINDER_ASTAR: pathfind_astar(map, grid, request.start, request.dest, &result.path); break;
+            case PATHFINDER_JPS: pathfind_jps(map, grid, request.start, request.dest, &result.path); break;
+            case PATHFINDER_HPA: pathfind_hpa(&clusters, map, grid, request.start, request.dest, &result.path); break;
+        }
+        result.ticket = request.ticket;
+        result.unit = request.unit;
+        result.version = map->version;
+
+        u64 searchtime = get_nanoseconds() - start;
+
+        guard.lock();
+        service->searchtime += searchtime;
+        service->searches++;
+        service->results.push_back(std::move(result));
+        release_snapshot(service, request.snapshot);
+        service->busy--;
+        if(service->busy == 0 && service->requests.empty())
+            service->idle.notify_all();
+    }
+
+    if(grid != NULL)
+        dispose_path_grid(grid);
+}
+
+//threads of 0 uses one per core, minus the one running the game
+static inline
+void start_path_service(PathService* service, u32 threads, bool lockstep) {
+    if(threads == 0)
+        threads = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1;
+
+    service->snapshot = NULL;
+    service->spare = NULL;
+    service->nextticket = 1;
+    service->busy = 0;
+    service->lockstep = lockstep;
+    service->quit = false;
+    service->searchtime = 0;
+    service->searches = 0;
+    for(u32 i = 0; i < threads; ++i)
+        service->workers.push_back(std::thread(path_worker, service));
+}
+
+static inline
+void stop_path_service(PathService* service) {
+    {
+        std::lock_guard<std::mutex> guard(service->lock);
+        service->quit = true;
+    }
+    service->wake.notify_all();
+    for(u32 i = 0; i < service->workers.size(); ++i)
+        service->workers[i].join();
+    service->workers.clear();
+
+    //workers are gone, so anything still queued holds the only references
+    for(u32 i = 0; i < service->requests.size(); ++i)
+        release_snapshot(service, service->requests[i].snapshot);
+    service->requests.clear();
+    service->results.clear();
+    if(service->snapshot != NULL) {
+        GridSnapshot* last = service->snapshot;
+        service->snapshot = NULL;
+        last->refs++;
+        release_snapshot(service, last);
+    }
+    if(service->spare != NULL) {
+        dispose_snapshot(service->spare);
+        service->spare = NULL;
+    }
+}
+
+//queues a search from start to dest on the map as it is right now. the ticket
+//comes back on the matching PathResult.
+static inline
+u32 request_path(PathService* service, Map* map, u32 unit, vec2 start, vec2 dest, Pathfinder pathfinder) {
+    std::lock_guard<std::mutex> guard(service->lock);
+
+    if(service->snapshot == NULL || service->snapshot->map.version != map->version) {
+        GridSnapshot* old = service->snapshot;
+        service->snapshot = take_snapshot(service, map);
+
+        if(old != NULL) {
+            old->refs++;
+            release_snapshot(service, old);
+        }
+    }
+
+    PathRequest request;
+    request.ticket = service->nextticket++;
+    request.unit = unit;
+    request.start = start;
+    request.dest = dest;
+    request.pathfinder = pathfinder;
+    request.snapshot = service->snapshot;
+    request.snapshot->refs++;
+    service->requests.push_back(request);
+    service->wake.notify_one();
+
+    return request.ticket;
+}
+
+//moves every finished result into out, replacing what was there, in the order
+//they were asked for. in lockstep this waits for every search still queued.
+static inline
+void collect_path_results(PathService* service, std::vector<PathResult>* out) {
+    out->clear();
+    {
+        std::unique_lock<std::mutex> guard(service->lock);
+        while(service->lockstep && (service->busy > 0 || !service->requests.empty()))
+            service->idle.wait(guard);
+        out->swap(service->results);
+    }
+    std::sort(out->begin(), out->end(), [](const PathResult& a, const PathResult& b) { return a.ticket < b.ticket; });
+}
+
+#endif
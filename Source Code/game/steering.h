@@ -0,0 +1,284 @@
+#ifndef STEERING_H
+#define STEERING_H
+
+#include <vector>
+#include <math.h>
+#include "core.h"
+#include "map.h"
+#include "unitstore.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define STEER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define STEER_TARGET_SSE
+#define STEER_TARGET_AVX2
+#else
+#include <cpuid.h>
+//gcc and clang only emit these instructions in functions marked for them, so
+//the rest of the game still runs on cpus without them
+#define STEER_TARGET_SSE __attribute__((target("sse2")))
+#define STEER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+//
+//   STEERING
+//
+
+//seek, the force cap and integration for every unit in one pass over the unit
+//arrays, 4 or 8 units at a time where the cpu allows. the vector versions use
+//the same exact sqrt and divide in the same order as the scalar one, so all
+//three move units identically. speeds and forces are tuned per tick of
+//SIM_DT, step is how many of those the tick being run is worth. separation
+//comes in through SteerInputs, it is gathered from the unit hash one unit at
+//a time and stays scalar.
+
+enum SteerKernel {
+    STEER_SCALAR,
+    STEER_SSE,
+    STEER_AVX2,
+};
+
+//filled per unit by the caller each tick. units that are not seeking keep the
+//force they had.
+struct SteerInputs {
+    std::vector<f32> tx; //where the unit is heading, in pixels
+    std::vector<f32> ty;
+    std::vector<f32> sx; //separation push
+    std::vector<f32> sy;
+    std::vector<i32> seeking; //-1 if the unit has somewhere to go, else 0
+};
+
+static inline
+void resize_steer_inputs(SteerInputs* in, u32 count) {
+    in->tx.resize(count);
+    in->ty.resize(count);
+    in->sx.resize(count);
+    in->sy.resize(count);
+    in->seeking.resize(count);
+}
+
+static inline
+SteerKernel detect_steer_kernel() {
+#ifdef STEER_X86
+    i32 info[4];
+#ifdef _MSC_VER
+    __cpuid(info, 0);
+    i32 leaves = info[0];
+    __cpuid(info, 1);
+#else
+    u32 a, b, c, d;
+    i32 leaves = __get_cpuid_max(0, NULL);
+    __cpuid(1, a, b, c, d);
+    info[0] = a; info[1] = b; info[2] = c; info[3] = d;
+#endif
+    bool sse2 = (info[3] >> 26) & 1;
+    bool osxsave = (info[2] >> 27) & 1;
+    bool avx = (info[2] >> 28) & 1;
+
+    bool avx2 = false;
+    if(leaves >= 7 && osxsave && avx) {
+        //the os has to save the ymm registers too, not just the cpu support them
+#ifdef _MSC_VER
+        u64 xcr0 = _xgetbv(0);
+        __cpuidex(info, 7, 0);
+#else
+        u32 lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        u64 xcr0 = ((u64)hi << 32) | lo;
+        __cpuid_count(7, 0, a, b, c, d);
+        info[1] = b;
+#endif
+        avx2 = (xcr0 & 6) == 6 && ((info[1] >> 5) & 1);
+    }
+
+    if(avx2)
+        return STEER_AVX2;
+    if(sse2)
+        return STEER_SSE;
+#endif
+    return STEER_SCALAR;
+}
+
+static inline
+const char* steer_kernel_name(SteerKernel kernel) {
+    switch(kernel) {
+        case STEER_SCALAR: return "scalar";
+        case STEER_SSE: return "sse";
+        case STEER_AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+static inline
+void steer_units_scalar(UnitStore* units, SteerInputs* in, f32 step, u32 first, u32 count) {
+    f32* x = units->x.data();
+    f32* y = units->y.data();
+    f32* vx = units->vx.data();
+    f32* vy = units->vy.data();
+    f32* fx = units->fx.data();
+    f32* fy = units->fy.data();
+
+    for(u32 i = first; i < count; ++i) {
+        if(in->seeking[i]) {
+            //calculate_seek plus the separation push
+            f32 dx = in->tx[i] - x[i];
+            f32 dy = in->ty[i] - y[i];
+            f32 len = sqrtf(dx * dx + dy * dy);
+            if(len != 0) {
+                dx = dx / len;
+                dy = dy / len;
+            }
+            fx[i] = ((MAX_SPEED * dx) * 2 - vx[i]) + in->sx[i];
+            fy[i] = ((MAX_SPEED * dy) * 2 - vy[i]) + in->sy[i];
+        }
+
+        f32 scale = MAX_FORCE / sqrtf(fx[i] * fx[i] + fy[i] * fy[i]);
+        scale = scale < 1.0f ? scale : 1.0f;
+        fx[i] = fx[i] * scale;
+        fy[i] = fy[i] * scale;
+
+        vx[i] = vx[i] + SCALING_FACTOR * fx[i] * step;
+        vy[i] = vy[i] + SCALING_FACTOR * fy[i] * step;
+        scale = MAX_SPEED / sqrtf(vx[i] * vx[i] + vy[i] * vy[i]);
+        scale = scale < 1.0f ? scale : 1.0f;
+        vx[i] = vx[i] * scale;
+        vy[i] = vy[i] * scale;
+
+        x[i] = x[i] + vx[i] * step;
+        y[i] = y[i] + vy[i] * step;
+    }
+}
+
+#ifdef STEER_X86
+//min(a, b) with b = 1 matches "scale < 1 ? scale : 1", nan included
+STEER_TARGET_SSE static inline
+u32 steer_units_sse(UnitStore* units, SteerInputs* in, f32 step, u32 count) {
+    f32* x = units->x.data();
+    f32* y = units->y.data();
+    f32* vx = units->vx.data();
+    f32* vy = units->vy.data();
+    f32* fx = units->fx.data();
+    f32* fy = units->fy.data();
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 two = _mm_set1_ps(2.0f);
+    __m128 speed = _mm_set1_ps(MAX_SPEED);
+    __m128 maxforce = _mm_set1_ps(MAX_FORCE);
+    __m128 scaling = _mm_set1_ps(SCALING_FACTOR);
+    __m128 steps = _mm_set1_ps(step);
+
+    u32 i = 0;
+    for(; i + 4 <= count; i += 4) {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 pvx = _mm_loadu_ps(vx + i);
+        __m128 pvy = _mm_loadu_ps(vy + i);
+        __m128 seeking = _mm_castsi128_ps(_mm_loadu_si128((__m128i*)(in->seeking.data() + i)));
+
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(in->tx.data() + i), px);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(in->ty.data() + i), py);
+        __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        __m128 nonzero = _mm_cmpneq_ps(len, zero);
+        dx = _mm_or_ps(_mm_and_ps(nonzero, _mm_div_ps(dx, len)), _mm_andnot_ps(nonzero, dx));
+        dy = _mm_or_ps(_mm_and_ps(nonzero, _mm_div_ps(dy, len)), _mm_andnot_ps(nonzero, dy));
+        __m128 seekx = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_mul_ps(speed, dx), two), pvx), _mm_loadu_ps(in->sx.data() + i));
+        __m128 seeky = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_mul_ps(speed, dy), two), pvy), _mm_loadu_ps(in->sy.data() + i));
+        __m128 pfx = _mm_or_ps(_mm_and_ps(seeking, seekx), _mm_andnot_ps(seeking, _mm_loadu_ps(fx + i)));
+        __m128 pfy = _mm_or_ps(_mm_and_ps(seeking, seeky), _mm_andnot_ps(seeking, _mm_loadu_ps(fy + i)));
+
+        __m128 scale = _mm_min_ps(_mm_div_ps(maxforce, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(pfx, pfx), _mm_mul_ps(pfy, pfy)))), one);
+        pfx = _mm_mul_ps(pfx, scale);
+        pfy = _mm_mul_ps(pfy, scale);
+
+        pvx = _mm_add_ps(pvx, _mm_mul_ps(_mm_mul_ps(scaling, pfx), steps));
+        pvy = _mm_add_ps(pvy, _mm_mul_ps(_mm_mul_ps(scaling, pfy), steps));
+        scale = _mm_min_ps(_mm_div_ps(speed, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(pvx, pvx), _mm_mul_ps(pvy, pvy)))), one);
+        pvx = _mm_mul_ps(pvx, scale);
+        pvy = _mm_mul_ps(pvy, scale);
+
+        _mm_storeu_ps(fx + i, pfx);
+        _mm_storeu_ps(fy + i, pfy);
+        _mm_storeu_ps(vx + i, pvx);
+        _mm_storeu_ps(vy + i, pvy);
+        _mm_storeu_ps(x + i, _mm_add_ps(px, _mm_mul_ps(pvx, steps)));
+        _mm_storeu_ps(y + i, _mm_add_ps(py, _mm_mul_ps(pvy, steps)));
+    }
+    return i;
+}
+
+STEER_TARGET_AVX2 static inline
+u32 steer_units_avx2(UnitStore* units, SteerInputs* in, f32 step, u32 count) {
+    f32* x = units->x.data();
+    f32* y = units->y.data();
+    f32* vx = units->vx.data();
+    f32* vy = units->vy.data();
+    f32* fx = units->fx.data();
+    f32* fy = units->fy.data();
+
+    __m256 zero = _mm256_setzero_ps();
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 two = _mm256_set1_ps(2.0f);
+    __m256 speed = _mm256_set1_ps(MAX_SPEED);
+    __m256 maxforce = _mm256_set1_ps(MAX_FORCE);
+    __m256 scaling = _mm256_set1_ps(SCALING_FACTOR);
+    __m256 steps = _mm256_set1_ps(step);
+
+    u32 i = 0;
+    for(; i + 8 <= count; i += 8) {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 pvx = _mm256_loadu_ps(vx + i);
+        __m256 pvy = _mm256_loadu_ps(vy + i);
+        __m256 seeking = _mm256_castsi256_ps(_mm256_loadu_si256((__m256i*)(in->seeking.data() + i)));
+
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(in->tx.data() + i), px);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(in->ty.data() + i), py);
+        __m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        __m256 nonzero = _mm256_cmp_ps(len, zero, _CMP_NEQ_UQ);
+        dx = _mm256_blendv_ps(dx, _mm256_div_ps(dx, len), nonzero);
+        dy = _mm256_blendv_ps(dy, _mm256_div_ps(dy, len), nonzero);
+        __m256 seekx = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(speed, dx), two), pvx), _mm256_loadu_ps(in->sx.data() + i));
+        __m256 seeky = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(speed, dy), two), pvy), _mm256_loadu_ps(in->sy.data() + i));
+        __m256 pfx = _mm256_blendv_ps(_mm256_loadu_ps(fx + i), seekx, seeking);
+        __m256 pfy = _mm256_blendv_ps(_mm256_loadu_ps(fy + i), seeky, seeking);
+
+        __m256 scale = _mm256_min_ps(_mm256_div_ps(maxforce, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(pfx, pfx), _mm256_mul_ps(pfy, pfy)))), one);
+        pfx = _mm256_mul_ps(pfx, scale);
+        pfy = _mm256_mul_ps(pfy, scale);
+
+        pvx = _mm256_add_ps(pvx, _mm256_mul_ps(_mm256_mul_ps(scaling, pfx), steps));
+        pvy = _mm256_add_ps(pvy, _mm256_mul_ps(_mm256_mul_ps(scaling, pfy), steps));
+        scale = _mm256_min_ps(_mm256_div_ps(speed, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(pvx, pvx), _mm256_mul_ps(pvy, pvy)))), one);
+        pvx = _mm256_mul_ps(pvx, scale);
+        pvy = _mm256_mul_ps(pvy, scale);
+
+        _mm256_storeu_ps(fx + i, pfx);
+        _mm256_storeu_ps(fy + i, pfy);
+        _mm256_storeu_ps(vx + i, pvx);
+        _mm256_storeu_ps(vy + i, pvy);
+        _mm256_storeu_ps(x + i, _mm256_add_ps(px, _mm256_mul_ps(pvx, steps)));
+        _mm256_storeu_ps(y + i, _mm256_add_ps(py, _mm256_mul_ps(pvy, steps)));
+    }
+    return i;
+}
+#endif
+
+//in has to hold an entry for every unit
+static inline
+void steer_units(UnitStore* units, SteerInputs* in, SteerKernel kernel, f32 step) {
+    u32 count = unit_count(units);
+    u32 done = 0;
+#ifdef STEER_X86
+    if(kernel == STEER_AVX2)
+        done = steer_units_avx2(units, in, step, count);
+    else if(kernel == STEER_SSE)
+        done = steer_units_sse(units, in, step, count);
+#endif
+    steer_units_scalar(units, in, step, done, count);
+}
+
+#endif
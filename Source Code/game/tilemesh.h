@@ -0,0 +1,194 @@
+#ifndef TILEMESH_H
+#define TILEMESH_H
+
+#include <vector>
+#include "bahamut.h"
+#include "map.h"
+
+//
+//   TILE MESHES
+//
+
+//the map is drawn from one instance buffer per chunk, built in map space the
+//first time the chunk is on screen and rebuilt only when its entry in
+//map->chunkversions moves. scrolling just changes the view matrix, so a frame
+//costs a draw call per visible chunk however many tiles are showing. a vertex
+//batch has no instancing, so there the visible tiles go through the batch.
+
+struct ChunkMesh {
+    u32 vao;
+    u32 vbo;
+    u32 quads;
+    u32 version; //of the chunk when the buffer was filled
+};
+
+struct TileMeshes {
+    std::vector<ChunkMesh> chunks; //vao of 0 until first drawn
+    u32 ebo; //indices of one quad, shared by every chunk
+    i32 chunkswide;
+    i32 chunkshigh;
+    bool layered; //tileset is in a layered atlas, texid is then the layer
+};
+
+static inline
+void dispose_tile_meshes(TileMeshes* meshes) {
+    for(u32 i = 0; i < meshes->chunks.size(); ++i) {
+        if(meshes->chunks[i].vao != 0) {
+            glDeleteVertexArrays(1, &meshes->chunks[i].vao);
+            glDeleteBuffers(1, &meshes->chunks[i].vbo);
+        }
+    }
+    meshes->chunks.clear();
+    if(meshes->ebo != 0)
+        glDeleteBuffers(1, &meshes->ebo);
+    meshes->ebo = 0;
+}
+
+//sized for the map on first use and whenever a different sized one or tileset shows up
+static inline
+void fit_tile_meshes(TileMeshes* meshes, Map* map, Texture tileset) {
+    bool layered = tileset.layer != 0;
+    if(meshes->ebo != 0 && meshes->chunkswide == map->chunkswide && meshes->chunkshigh == map->chunkshigh && meshes->layered == layered)
+        return;
+    dispose_tile_meshes(meshes);
+    meshes->chunkswide = map->chunkswide;
+    meshes->chunkshigh = map->chunkshigh;
+    meshes->layered = layered;
+    meshes->chunks.resize(map->chunkswide * map->chunkshigh);
+    for(u32 i = 0; i < meshes->chunks.size(); ++i)
+        meshes->chunks[i] = {0, 0, 0, 0};
+
+    GLushort indices[6] = {0, 1, 2, 2, 3, 0};
+    glGenBuffers(1, &meshes->ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshes->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+//same instance layout as an instanced RenderBatch so the instanced 2D shader
+//draws it, with the tileset always in the first texture slot. on a layered
+//batch the tileset's layer stands in for the slot.
+static inline
+void build_chunk_mesh(TileMeshes* meshes, Map* map, Texture tileset, u32 chunk) {
+    ChunkMesh* mesh = &meshes->chunks[chunk];
+    if(mesh->vao == 0) {
+        glGenVertexArrays(1, &mesh->vao);
+        glBindVertexArray(mesh->vao);
+        glGenBuffers(1, &mesh->vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(SpriteInstance) * CHUNK_AREA, NULL, GL_DYNAMIC_DRAW);
+        GLsizei stride = sizeof(SpriteInstance);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof(SpriteInstance, pos));
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (const GLvoid*)offsetof(SpriteInstance, color));
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, (const GLvoid*)offsetof(SpriteInstance, uv));
+        if(meshes->layered)
+            glVertexAttribIPointer(3, 1, GL_UNSIGNED_SHORT, stride, (const GLvoid*)offsetof(SpriteInstance, texid));
+        else
+            glVertexAttribPointer(3, 1, GL_UNSIGNED_SHORT, GL_FALSE, stride, (const GLvoid*)offsetof(SpriteInstance, texid));
+        glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof(SpriteInstance, size));
+        glVertexAttribPointer(5, 1, GL_SHORT, GL_FALSE, stride, (const GLvoid*)offsetof(SpriteInstance, angle));
+        for(u32 i = 0; i < 6; ++i) {
+            glVertexAttribDivisor(i, 1);
+            glEnableVertexAttribArray(i);
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshes->ebo);
+        glBindVertexArray(0);
+    }
+
+    SpriteInstance tiles[CHUNK_AREA];
+    SpriteInstance* tile = tiles;
+    i32 x0 = (chunk % map->chunkswide) * CHUNK_SIZE;
+    i32 y0 = (chunk / map->chunkswide) * CHUNK_SIZE;
+    i32 x1 = std::min(x0 + CHUNK_SIZE, map->width);
+    i32 y1 = std::min(y0 + CHUNK_SIZE, map->height);
+    //the tileset may be one region of an atlas
+    f32 u = (f32)TILE_SIZE / tileset.width * (tileset.region[2] - tileset.region[0]);
+    f32 v = (f32)TILE_SIZE / tileset.height * (tileset.region[3] - tileset.region[1]);
+    for(i32 y = y0; y < y1; ++y) {
+        for(i32 x = x0; x < x1; ++x) {
+            i32 id = get_tile(map, x, y);
+            f32 s = tileset.region[0] + (id % TILESET_WIDTH) * u;
+            f32 t = tileset.region[1] + (id / TILESET_WIDTH) * v;
+            tile->pos = V2(x * TILE_SIZE, y * TILE_SIZE);
+            tile->size = V2(TILE_SIZE, TILE_SIZE);
+            tile->color = 0xFFFFFFFF;
+            tile->uv[0] = pack_unorm16(s);
+            tile->uv[1] = pack_unorm16(t);
+            tile->uv[2] = pack_unorm16(s + u);
+            tile->uv[3] = pack_unorm16(t + v);
+            tile->texid = meshes->layered ? tileset.layer : 1;
+            tile->angle = 0;
+            tile++;
+        }
+    }
+
+    mesh->quads = tile - tiles;
+    mesh->version = map->chunkversions[chunk];
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(SpriteInstance) * mesh->quads, tiles);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//the tiles on screen one sprite at a time, for batches without instancing
+static inline
+void draw_visible_tiles(RenderBatch* batch, Map* map, Texture tileset) {
+    i32 x0 = std::max(-map->x / TILE_SIZE, 0);
+    i32 y0 = std::max(-map->y / TILE_SIZE, 0);
+    i32 x1 = std::min((-map->x + get_virtual_width()) / TILE_SIZE + 1, map->width);
+    i32 y1 = std::min((-map->y + get_virtual_height()) / TILE_SIZE + 1, map->height);
+    for(i32 y = y0; y < y1; ++y) {
+        for(i32 x = x0; x < x1; ++x) {
+            i32 id = get_tile(map, x, y);
+            Rect source = {(f32)(id % TILESET_WIDTH * TILE_SIZE), (f32)(id / TILESET_WIDTH * TILE_SIZE), (f32)TILE_SIZE, (f32)TILE_SIZE};
+            Rect dest = {(f32)(x * TILE_SIZE + map->x), (f32)(y * TILE_SIZE + map->y), (f32)TILE_SIZE, (f32)TILE_SIZE};
+            draw_texture_EX(batch, tileset, source, dest);
+        }
+    }
+}
+
+//call between begin2D and end2D. on an instanced batch it draws straight away
+//with the batch's shader, so it lands under everything the batch draws this frame.
+static inline
+void draw_tile_meshes(TileMeshes* meshes, Map* map, Texture tileset, RenderBatch* batch) {
+    if(!batch->instanced) {
+        draw_visible_tiles(batch, map, tileset);
+        return;
+    }
+    Shader shader = batch->shader;
+    ShaderUniform* view = get_uniform(shader, "view");
+    fit_tile_meshes(meshes, map, tileset);
+
+    i32 x0 = (-map->x / TILE_SIZE) >> CHUNK_SHIFT;
+    i32 y0 = (-map->y / TILE_SIZE) >> CHUNK_SHIFT;
+    i32 x1 = ((-map->x + get_virtual_width()) / TILE_SIZE) >> CHUNK_SHIFT;
+    i32 y1 = ((-map->y + get_virtual_height()) / TILE_SIZE) >> CHUNK_SHIFT;
+    clamp(&x0, 0, map->chunkswide - 1);
+    clamp(&x1, 0, map->chunkswide - 1);
+    clamp(&y0, 0, map->chunkshigh - 1);
+    clamp(&y1, 0, map->chunkshigh - 1);
+
+    upload_mat4(view, translation(map->x, map->y, 0));
+    glActiveTexture(GL_TEXTURE0);
+    if(meshes->layered) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, tileset.ID);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, tileset.ID);
+        upload_int(batch->samplers[0], 0);
+    }
+
+    for(i32 cy = y0; cy <= y1; ++cy) {
+        for(i32 cx = x0; cx <= x1; ++cx) {
+            u32 chunk = cx + cy * map->chunkswide;
+            ChunkMesh* mesh = &meshes->chunks[chunk];
+            if(mesh->vao == 0 || mesh->version != map->chunkversions[chunk])
+                build_chunk_mesh(meshes, map, tileset, chunk);
+            glBindVertexArray(mesh->vao);
+            glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0, mesh->quads);
+        }
+    }
+
+    glBindVertexArray(0);
+    upload_mat4(view, identity());
+}
+
+#endif
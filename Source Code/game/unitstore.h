@@ -0,0 +1,199 @@
+#ifndef UNITSTORE_H
+#define UNITSTORE_H
+
+#include <vector>
+#include "core.h"
+#include "map.h"
+
+//
+//   PATH POOL
+//
+
+//every unit's path lives in one shared array of points. a span owns a stretch
+//of it, front first like the vectors the pathfinders fill, so units still
+//consume from the back. a path that outgrows its stretch moves to the end of
+//the array and the old stretch is garbage until the pool is compacted.
+
+struct PathSpan {
+    u32 offset;
+    u32 count;
+    u32 capacity;
+};
+
+struct PathPool {
+    std::vector<vec2> points;
+    u32 garbage; //points no span owns anymore
+};
+
+static inline
+vec2 path_back(PathPool* pool, PathSpan* span) {
+    return pool->points[span->offset + span->count - 1];
+}
+
+static inline
+void pop_path(PathSpan* span) {
+    span->count--;
+}
+
+static inline
+void clear_path(PathSpan* span) {
+    span->count = 0;
+}
+
+static inline
+void set_path(PathPool* pool, PathSpan* span, std::vector<vec2>* path) {
+    u32 count = path->size();
+    if(count > span->capacity) {
+        pool->garbage += span->capacity;
+        span->offset = pool->points.size();
+        span->capacity = count;
+        pool->points.resize(span->offset + count);
+    }
+    span->count = count;
+    if(count > 0)
+        memcpy(&pool->points[span->offset], path->data(), sizeof(vec2) * count);
+}
+
+static inline
+void release_path(PathPool* pool, PathSpan* span) {
+    pool->garbage += span->capacity;
+    span->offset = 0;
+    span->count = 0;
+    span->capacity = 0;
+}
+
+//packs the live part of every span to the front of the pool
+static inline
+void compact_path_pool(PathPool* pool, PathSpan* spans, u32 count) {
+    std::vector<vec2> points;
+    points.reserve(pool->points.size() - pool->garbage);
+    for(u32 i = 0; i < count; ++i) {
+        PathSpan* span = &spans[i];
+        u32 offset = points.size();
+        points.insert(points.end(), pool->points.begin() + span->offset, pool->points.begin() + span->offset + span->count);
+        span->offset = offset;
+        span->capacity = span->count;
+    }
+    pool->points.swap(points);
+    pool->garbage = 0;
+}
+
+//
+//   UNIT STORE
+//
+
+//units as parallel arrays indexed by a dense slot. what the steering and
+//integration loops touch every tick is kept in plain float arrays, the rest
+//of a unit sits in info. removing a unit moves the last one into its slot,
+//so anything that holds onto a unit across ticks keeps a UnitHandle instead.
+
+typedef u32 UnitHandle; //handle index in the low bits, how often it was reused above
+const u32 UNIT_HANDLE_BITS = 20;
+const u32 UNIT_HANDLE_MASK = (1 << UNIT_HANDLE_BITS) - 1;
+const u32 NO_UNIT = 0xFFFFFFFF;
+
+struct UnitStore {
+    std::vector<f32> x;
+    std::vector<f32> y;
+    std::vector<f32> vx;
+    std::vector<f32> vy;
+    std::vector<f32> fx;
+    std::vector<f32> fy;
+    std::vector<PathSpan> paths;
+    std::vector<Unit> info;
+    std::vector<UnitHandle> handles; //handle of the unit in each slot
+
+    std::vector<u32> slots; //slot of each handle index, NO_UNIT when free
+    std::vector<u32> reuses; //bumped each time a handle index is freed
+    std::vector<u32> freehandles;
+    PathPool pathpool;
+};
+
+static inline
+u32 unit_count(UnitStore* units) {
+    return units->x.size();
+}
+
+static inline
+vec2 unit_pos(UnitStore* units, u32 slot) {
+    return V2(units->x[slot], units->y[slot]);
+}
+
+//slot of the unit, or NO_UNIT if it has been removed
+static inline
+u32 unit_slot(UnitStore* units, UnitHandle handle) {
+    u32 index = handle & UNIT_HANDLE_MASK;
+    if(index >= units->slots.size() || (handle >> UNIT_HANDLE_BITS) != (units->reuses[index] & (0xFFFFFFFF >> UNIT_HANDLE_BITS)))
+        return NO_UNIT;
+    return units->slots[index];
+}
+
+static inline
+UnitHandle spawn_unit(UnitStore* units, vec2 pos, Unit* info) {
+    u32 index;
+    if(units->freehandles.size() > 0) {
+        index = units->freehandles.back();
+        units->freehandles.pop_back();
+    } else {
+        index = units->slots.size();
+        units->slots.push_back(NO_UNIT);
+        units->reuses.push_back(0);
+    }
+    UnitHandle handle = index | ((units->reuses[index] & (0xFFFFFFFF >> UNIT_HANDLE_BITS)) << UNIT_HANDLE_BITS);
+
+    units->slots[index] = unit_count(units);
+    units->x.push_back(pos.x);
+    units->y.push_back(pos.y);
+    units->vx.push_back(0);
+    units->vy.push_back(0);
+    units->fx.push_back(0);
+    units->fy.push_back(0);
+    units->paths.push_back({0, 0, 0});
+    units->info.push_back(*info);
+    units->handles.push_back(handle);
+    return handle;
+}
+
+static inline
+void remove_unit(UnitStore* units, UnitHandle handle) {
+    u32 slot = unit_slot(units, handle);
+    if(slot == NO_UNIT)
+        return;
+    release_path(&units->pathpool, &units->paths[slot]);
+
+    u32 last = unit_count(units) - 1;
+    units->x[slot] = units->x[last];
+    units->y[slot] = units->y[last];
+    units->vx[slot] = units->vx[last];
+    units->vy[slot] = units->vy[last];
+    units->fx[slot] = units->fx[last];
+    units->fy[slot] = units->fy[last];
+    units->paths[slot] = units->paths[last];
+    units->info[slot] = units->info[last];
+    units->handles[slot] = units->handles[last];
+    units->slots[units->handles[slot] & UNIT_HANDLE_MASK] = slot;
+
+    units->x.pop_back();
+    units->y.pop_back();
+    units->vx.pop_back();
+    units->vy.pop_back();
+    units->fx.pop_back();
+    units->fy.pop_back();
+    units->paths.pop_back();
+    units->info.pop_back();
+    units->handles.pop_back();
+
+    u32 index = handle & UNIT_HANDLE_MASK;
+    units->slots[index] = NO_UNIT;
+    units->reuses[index]++;
+    units->freehandles.push_back(index);
+}
+
+//worth doing once a tick, it only runs when most of the pool is garbage
+static inline
+void tidy_unit_paths(UnitStore* units) {
+    if(units->pathpool.garbage > 64 && units->pathpool.garbage * 2 > units->pathpool.points.size())
+        compact_path_pool(&units->pathpool, units->paths.data(), unit_count(units));
+}
+
+#endif